@@ -0,0 +1,42 @@
+#include "LatencyRecorder.h"
+
+#include <algorithm>
+#include <numeric>
+
+void LatencyRecorder::add(int64_t nanoseconds) {
+    samples.push_back(nanoseconds);
+}
+
+void LatencyRecorder::addSince(std::chrono::steady_clock::time_point start) {
+    add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+size_t LatencyRecorder::count() const {
+    return samples.size();
+}
+
+double toMicroseconds(int64_t nanoseconds) {
+    return nanoseconds / 1000.0;
+}
+
+nlohmann::json LatencyRecorder::summarise(nlohmann::json properties) const {
+    properties["samples"] = samples.size();
+    if (samples.empty()) {
+        return properties;
+    }
+
+    auto sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        return toMicroseconds(sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))]);
+    };
+
+    auto total = std::accumulate(sorted.begin(), sorted.end(), (int64_t) 0);
+    properties["perSecond"] = total > 0 ? sorted.size() * 1e9 / total : 0;
+    properties["meanUs"] = toMicroseconds(total) / sorted.size();
+    properties["p50Us"] = percentile(0.5);
+    properties["p90Us"] = percentile(0.9);
+    properties["p99Us"] = percentile(0.99);
+    properties["maxUs"] = toMicroseconds(sorted.back());
+    return properties;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+/**
+ * Collects one latency sample per operation of a benchmark and summarises them as throughput and percentiles.
+ */
+class LatencyRecorder {
+    std::vector<int64_t> samples;
+
+public:
+    void add(int64_t nanoseconds);
+
+    /**
+     * Records the time from start until now.
+     */
+    void addSince(std::chrono::steady_clock::time_point start);
+
+    /**
+     * Times fn and records it.
+     */
+    template <class F>
+    void time(F fn) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        addSince(start);
+    }
+
+    size_t count() const;
+
+    /**
+     * @return { samples, perSecond, meanUs, p50Us, p90Us, p99Us, maxUs } merged into properties, which should identify
+     * the benchmark.
+     */
+    nlohmann::json summarise(nlohmann::json properties) const;
+};
@@ -0,0 +1,134 @@
+#include "SyntheticVideo.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+}
+
+const int FRAME_RATE = 24;
+const int CUT_INTERVAL = 100;
+
+std::string getSyntheticVideoName(const SyntheticVideoSpec& spec) {
+    std::stringstream ss;
+    ss << spec.codec << "-" << spec.width << "x" << spec.height << "-gop" << spec.gopSize;
+    return ss.str();
+}
+
+void fillFrame(AVFrame *frame, int index) {
+    auto scene = index / CUT_INTERVAL;
+    auto t = index % CUT_INTERVAL;
+    auto seed = (uint32_t) (index * 2654435761u);
+
+    auto luma = frame->data[0];
+    for (auto y = 0; y < frame->height; y++) {
+        auto row = luma + y * frame->linesize[0];
+        for (auto x = 0; x < frame->width; x++) {
+            // Each scene scrolls its gradient a different way.
+            auto gradient = scene % 2 == 0 ? (x + y + t * 4) : (x - y * 2 + t * 3);
+            auto value = (gradient & 0xFF) / 2 + 32;
+
+            auto dx = x - (frame->width / 4 + t * frame->width / (2 * CUT_INTERVAL));
+            auto dy = y - frame->height / 2;
+            if (dx * dx + dy * dy < frame->height * frame->height / 16) {
+                value += 96;
+            }
+
+            seed = seed * 1664525u + 1013904223u;
+            value += (int) (seed >> 28) - 8;
+            row[x] = (uint8_t) std::min(255, std::max(0, value));
+        }
+    }
+
+    for (auto plane = 1; plane < 3; plane++) {
+        for (auto y = 0; y < (frame->height + 1) / 2; y++) {
+            std::fill(frame->data[plane] + y * frame->linesize[plane],
+                      frame->data[plane] + y * frame->linesize[plane] + (frame->width + 1) / 2, 128);
+        }
+    }
+}
+
+void encode(AVCodecContext *context, AVFrame *frame, AVPacket *packet, AVFormatContext *format, AVStream *stream) {
+    if (avcodec_send_frame(context, frame) < 0) {
+        throw std::runtime_error("Cannot send frame to encoder");
+    }
+    while (avcodec_receive_packet(context, packet) == 0) {
+        av_packet_rescale_ts(packet, context->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        if (av_interleaved_write_frame(format, packet) < 0) {
+            throw std::runtime_error("Cannot write packet");
+        }
+    }
+}
+
+bool tryWriteSyntheticVideo(const SyntheticVideoSpec& spec, const std::string& path) {
+    auto codec = avcodec_find_encoder_by_name(spec.codec.c_str());
+    if (!codec) {
+        return false;
+    }
+
+    auto context = avcodec_alloc_context3(codec);
+    context->width = spec.width;
+    context->height = spec.height;
+    context->time_base = { 1, FRAME_RATE };
+    context->framerate = { FRAME_RATE, 1 };
+    context->gop_size = spec.gopSize;
+    context->max_b_frames = codec->id == AV_CODEC_ID_MJPEG ? 0 : 2;
+    context->pix_fmt = codec->id == AV_CODEC_ID_MJPEG ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+    context->bit_rate = (int64_t) spec.width * spec.height * 3;
+
+    AVFormatContext *format = nullptr;
+    if (avformat_alloc_output_context2(&format, nullptr, "matroska", path.c_str()) < 0) {
+        avcodec_free_context(&context);
+        throw std::runtime_error("Cannot create matroska muxer");
+    }
+    if (format->oformat->flags & AVFMT_GLOBALHEADER) {
+        context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(context, codec, nullptr) < 0) {
+        avcodec_free_context(&context);
+        avformat_free_context(format);
+        return false;
+    }
+
+    auto stream = avformat_new_stream(format, nullptr);
+    avcodec_parameters_from_context(stream->codecpar, context);
+    stream->time_base = context->time_base;
+
+    if (avio_open(&format->pb, path.c_str(), AVIO_FLAG_WRITE) < 0 || avformat_write_header(format, nullptr) < 0) {
+        std::stringstream ss;
+        ss << "Cannot write " << path;
+        throw std::runtime_error(ss.str());
+    }
+
+    auto frame = av_frame_alloc();
+    frame->format = context->pix_fmt;
+    frame->width = spec.width;
+    frame->height = spec.height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        throw std::runtime_error("Cannot allocate frame");
+    }
+
+    auto packet = av_packet_alloc();
+    for (auto i = 0; i < spec.frames; i++) {
+        if (av_frame_make_writable(frame) < 0) {
+            throw std::runtime_error("Cannot write to frame");
+        }
+        fillFrame(frame, i);
+        frame->pts = i;
+        encode(context, frame, packet, format, stream);
+    }
+    encode(context, nullptr, packet, format, stream);
+    av_write_trailer(format);
+
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&context);
+    avio_closep(&format->pb);
+    avformat_free_context(format);
+    return true;
+}
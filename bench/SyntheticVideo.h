@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+struct SyntheticVideoSpec {
+    /**
+     * libav encoder name, e.g. mpeg4.
+     */
+    std::string codec;
+    int width;
+    int height;
+    int gopSize;
+    int frames;
+};
+
+/**
+ * @return e.g. mpeg4-1280x720-gop12
+ */
+std::string getSyntheticVideoName(const SyntheticVideoSpec& spec);
+
+/**
+ * Encodes a deterministic test movie into a matroska file: a scrolling gradient with a moving highlight and film grain,
+ * with a cut every 100 frames so that a long GOP still sees scene changes.
+ * @return false if this libav build cannot encode with spec.codec.
+ */
+bool tryWriteSyntheticVideo(const SyntheticVideoSpec& spec, const std::string& path);
@@ -0,0 +1,656 @@
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "SyntheticVideo.h"
+#include "LatencyRecorder.h"
+#include "../src/bake/BakedMovie.h"
+#include "../src/bake/FrameCodec.h"
+#include "../src/config/Config.h"
+#include "../src/display/Display.h"
+#include "../src/dither/DitherService.h"
+#include "../src/frame/FrameService.h"
+#include "../src/prefetch/PrefetchService.h"
+#ifdef __linux__
+#include "../src/epaper/EPaperDisplay.h"
+#include "../src/gpio/Gpio.h"
+#include "../src/spi/Spi.h"
+#endif
+
+using json = nlohmann::json;
+
+const std::vector<std::string> CODECS = { "mpeg4", "libx264", "mjpeg" };
+const std::vector<std::pair<int, int>> RESOLUTIONS = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+const std::vector<int> GOP_SIZES = { 12, 120 };
+
+// The 7.5" panel, then the larger Waveshare panels and a size past them, to see how the dither scales across cores.
+const std::vector<std::pair<int, int>> PANEL_SIZES = { { 800, 480 }, { 1304, 984 }, { 1600, 1200 }, { 2560, 1440 } };
+
+// Decoded frames kept for the dither and display benchmarks. Synthetic movies are --frames long, by default three
+// key intervals of a bake so that the frame store benchmark sees both key and delta frames in proportion.
+const int DITHER_FRAMES = 24;
+
+// Panels played at once, by one process sharing its workers and by a process each.
+const std::vector<int> PANEL_COUNTS = { 2, 4 };
+
+const int SEEKS = 16;
+const int PACK_REPEATS = 200;
+// Frames of the display push pattern, a full change every so often among small moving changes.
+const int PUSH_FRAMES = 60;
+const int PUSH_FULL_CHANGE_INTERVAL = 20;
+
+struct BenchArguments {
+    std::string program;
+    int frames;
+    bool synthetic;
+    std::string workPath;
+    std::string outPath;
+    std::vector<std::string> movies;
+};
+
+struct Movie {
+    std::string name;
+    std::string path;
+};
+
+BenchArguments parseArguments(int argc, char *argv[]) {
+    BenchArguments arguments = {
+        .program = argv[0], .frames = 360, .synthetic = true, .workPath = "/tmp/vsmp_bench", .outPath = "", .movies = {}
+    };
+    for (auto i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--frames" && i + 1 < argc) {
+            arguments.frames = std::stoi(argv[++i]);
+        } else if (argument == "--work" && i + 1 < argc) {
+            arguments.workPath = argv[++i];
+        } else if (argument == "--out" && i + 1 < argc) {
+            arguments.outPath = argv[++i];
+        } else if (argument == "--no-synthetic") {
+            arguments.synthetic = false;
+        } else if (argument.compare(0, 2, "--") == 0) {
+            std::cerr << "Usage: vsmp_bench [--frames n] [--work dir] [--out results.json] [--no-synthetic] [movie...]"
+                      << std::endl;
+            exit(argument == "--help" ? 0 : 1);
+        } else {
+            arguments.movies.push_back(argument);
+        }
+    }
+    return arguments;
+}
+
+Options getBenchOptions(const std::string& workPath) {
+    return {
+        .path = workPath,
+        .width = EPD_WIDTH,
+        .height = EPD_HEIGHT,
+        .offsetX = 0,
+        .offsetY = 0,
+        .frameSkip = 1,
+        .frameSkipMode = exactFrame,
+        .playback = { .mode = frameSkipPlayback, .movieSecondsPerHour = 30, .daysPerMovie = 0 },
+        .decoder = { .lowres = true, .threads = 0 },
+        .scaler = { .quality = lanczosScaling, .lumaFastPath = true },
+        .displaySeconds = 0,
+        .schedule = { .enabled = false, .hourFrom = 0, .hoursFor = 24 },
+        .dither = { .engine = fixedPoint, .algorithm = floydSteinberg, .threads = 1 },
+        .skip = { .nearBlackThreshold = 0, .changeThreshold = 0 },
+        .display = {
+            .backend = simulated,
+            .width = EPD_WIDTH,
+            .height = EPD_HEIGHT,
+            .simulatedPath = workPath + "/display",
+            .simulateLatency = false,
+            .spiSpeed = 10000000,
+            .busyTimeoutMs = 30000,
+            .partialRefresh = true,
+            .fullRefreshInterval = 10,
+            .partialAreaPercent = 50,
+            .spiDevice = "/dev/spidev0.0",
+            .rstPin = 17,
+            .dcPin = 25,
+            .busyPin = 24,
+        },
+        .state = { .syncFrames = 10, .syncSeconds = 300 },
+        .statsSeconds = 60,
+        .panelWorkers = 1,
+    };
+}
+
+std::string getIndexPath(const std::string& workPath, const Movie& movie) {
+    return workPath + "/" + movie.name + ".index.json";
+}
+
+/**
+ * Decodes the whole movie frame by frame.
+ * @return clones of the first DITHER_FRAMES frames, owned by the caller.
+ */
+std::vector<AVFrame*> benchDecode(json& results, const Movie& movie, const std::string& workPath, Options options,
+                                  int64_t& firstPts, int& frames) {
+    // The first open builds and persists the keyframe index, time it on its own.
+    LatencyRecorder open;
+    std::unique_ptr<FrameService> frameService;
+    open.time([&] {
+        frameService.reset(new FrameService(movie.path, getIndexPath(workPath, movie), nullptr, &options));
+    });
+    results.push_back(open.summarise({ { "benchmark", "open" }, { "movie", movie.name } }));
+
+    std::vector<AVFrame*> kept;
+    LatencyRecorder decode;
+    AVFrame *frame = nullptr;
+    frames = 0;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        if (!frameService->tryGetNext(&frame)) {
+            break;
+        }
+        decode.addSince(start);
+        if (frames++ == 0) {
+            firstPts = frame->pts;
+        }
+        if (kept.size() < DITHER_FRAMES) {
+            kept.push_back(av_frame_clone(frame));
+        }
+    }
+    results.push_back(decode.summarise({ { "benchmark", "decode" }, { "movie", movie.name } }));
+    return kept;
+}
+
+/**
+ * Seeks forward through the movie in even steps from a fresh decoder, as playback with a large frameSkip does.
+ */
+void benchSeek(json& results, const Movie& movie, const std::string& workPath, Options options, int64_t firstPts,
+               int frames, FrameSkipMode mode) {
+    options.frameSkipMode = mode;
+    FrameService frameService(movie.path, getIndexPath(workPath, movie), nullptr, &options);
+    auto stride = std::max(1, frames / SEEKS);
+
+    LatencyRecorder seek;
+    AVFrame *frame = nullptr;
+    for (auto i = 1; i < SEEKS; i++) {
+        auto pts = frameService.getPtsAfter(firstPts, i * stride);
+        auto start = std::chrono::steady_clock::now();
+        if (!frameService.trySeek(pts, &frame)) {
+            break;
+        }
+        seek.addSince(start);
+    }
+    results.push_back(seek.summarise({
+        { "benchmark", "seek" },
+        { "movie", movie.name },
+        { "mode", mode == exactFrame ? "exact" : "keyframe" },
+        { "strideFrames", stride },
+    }));
+}
+
+/**
+ * Runs every frame through DitherService, timing each stage.
+ * @return the dithered bitmaps of non-black frames.
+ */
+std::vector<std::vector<uint8_t>> benchDither(json& results, const Movie& movie, const VideoFormat& format,
+                                              Options options, const std::vector<AVFrame*>& frames) {
+    const std::vector<std::string> engines = { "float", "fixed" };
+    const std::vector<std::string> algorithms = { "floyd-steinberg", "atkinson", "sierra-lite", "bayer", "blue-noise" };
+    // Multi-threaded dithering is also timed where there are cores to spread it over.
+    std::vector<int> threadCounts = { 1 };
+    auto cores = (int) std::thread::hardware_concurrency();
+    if (cores > 1) {
+        threadCounts.push_back(cores);
+    }
+
+    std::vector<std::vector<uint8_t>> bitmaps;
+    for (auto engine : { floatingPoint, fixedPoint }) {
+        for (auto algorithm : { floydSteinberg, atkinson, sierraLite, bayer, blueNoise }) {
+            for (auto threads : threadCounts) {
+                options.dither = { .engine = engine, .algorithm = algorithm, .threads = threads };
+                DitherService ditherService(format, &options, EPD_WIDTH, EPD_HEIGHT, nullptr);
+
+                LatencyRecorder scale, blackCheck, dither;
+                for (auto frame : frames) {
+                    auto outcome = ditherService.tryDither(frame);
+                    scale.add(ditherService.timings.scale);
+                    blackCheck.add(ditherService.timings.blackCheck);
+                    if (outcome == frameDithered) {
+                        dither.add(ditherService.timings.dither);
+                        if (engine == fixedPoint && algorithm == floydSteinberg && threads == 1) {
+                            bitmaps.push_back(ditherService.result);
+                        }
+                    }
+                }
+
+                json properties = {
+                    { "movie", movie.name },
+                    { "engine", engines.at(engine) },
+                    { "algorithm", algorithms.at(algorithm) },
+                    { "threads", threads },
+                };
+                properties["benchmark"] = "scale";
+                results.push_back(scale.summarise(properties));
+                properties["benchmark"] = "blackCheck";
+                results.push_back(blackCheck.summarise(properties));
+                properties["benchmark"] = "dither";
+                results.push_back(dither.summarise(properties));
+            }
+        }
+    }
+    return bitmaps;
+}
+
+/**
+ * Dithers the frames at each of PANEL_SIZES with one thread and with every core, reporting how much faster the
+ * wavefront is for each engine.
+ */
+void benchDitherScaling(json& results, const Movie& movie, const VideoFormat& format, Options options,
+                        const std::vector<AVFrame*>& frames) {
+    auto cores = (int) std::thread::hardware_concurrency();
+    if (cores < 2) {
+        return;
+    }
+
+    const std::vector<std::string> engines = { "float", "fixed" };
+    for (const auto& size : PANEL_SIZES) {
+        options.width = size.first;
+        options.height = size.second;
+        for (auto engine : { floatingPoint, fixedPoint }) {
+            json summaries[2];
+            for (auto i = 0; i < 2; i++) {
+                auto threads = i == 0 ? 1 : cores;
+                options.dither = { .engine = engine, .algorithm = floydSteinberg, .threads = threads };
+                DitherService ditherService(format, &options, size.first, size.second, nullptr);
+
+                LatencyRecorder dither;
+                for (auto frame : frames) {
+                    if (ditherService.tryDither(frame) == frameDithered) {
+                        dither.add(ditherService.timings.dither);
+                    }
+                }
+                summaries[i] = dither.summarise({
+                    { "benchmark", "ditherScaling" },
+                    { "movie", movie.name },
+                    { "engine", engines.at(engine) },
+                    { "width", size.first },
+                    { "height", size.second },
+                    { "threads", threads },
+                });
+            }
+
+            double single = summaries[0].value("meanUs", 0.0);
+            double multi = summaries[1].value("meanUs", 0.0);
+            summaries[1]["speedup"] = multi > 0 ? single / multi : 0;
+            results.push_back(summaries[0]);
+            results.push_back(summaries[1]);
+        }
+    }
+}
+
+/**
+ * Packs a screen of 0/1 pixels to 1bpp with the scalar and the detected SIMD kernels.
+ */
+void benchPack(json& results) {
+    std::vector<uint8_t> pixels(EPD_WIDTH * EPD_HEIGHT);
+    std::mt19937 random(1);
+    for (auto& pixel : pixels) {
+        pixel = random() & 1;
+    }
+    std::vector<uint8_t> bitmap(pixels.size() / 8);
+
+    for (auto kernels : { &getScalarKernels(), &getPixelKernels() }) {
+        LatencyRecorder pack;
+        for (auto i = 0; i < PACK_REPEATS; i++) {
+            pack.time([&] {
+                for (auto y = 0; y < EPD_HEIGHT; y++) {
+                    packRow(*kernels, pixels.data() + y * EPD_WIDTH, EPD_WIDTH, bitmap.data(), y * EPD_WIDTH);
+                }
+            });
+        }
+        results.push_back(pack.summarise({ { "benchmark", "pack" }, { "kernels", kernels->name } }));
+    }
+}
+
+/**
+ * Prepares every frame of the movie as a bake with the default skip options does, compresses them as the bake does
+ * and expands them again as playback does. The ratio is only representative of a movie over several key intervals.
+ */
+void benchFrameStore(json& results, const Movie& movie, const std::string& workPath, Options options) {
+    options.skip = { .nearBlackThreshold = 2, .changeThreshold = 2 };
+    PrefetchService prefetch(movie.path, getIndexPath(workPath, movie), nullptr, &options, EPD_WIDTH, EPD_HEIGHT,
+                             AV_NOPTS_VALUE, -1, nullptr);
+
+    FrameEncoder encoder(KEY_FRAME_INTERVAL);
+    std::vector<std::pair<FrameEncoding, std::vector<uint8_t>>> encoded;
+    LatencyRecorder encode;
+    size_t compressedBytes = 0;
+    size_t keyFrames = 0;
+    PreparedFrame prepared;
+    while (prefetch.tryTakeNext(prepared)) {
+        encoded.emplace_back();
+        auto& entry = encoded.back();
+        encode.time([&] { entry.first = encoder.encode(prepared.bitmap, entry.second); });
+        compressedBytes += entry.second.size();
+        keyFrames += entry.first == keyFrame ? 1 : 0;
+    }
+    if (encoded.empty()) {
+        return;
+    }
+
+    std::vector<uint8_t> frame(EPD_WIDTH * EPD_HEIGHT / 8);
+    LatencyRecorder decode;
+    for (const auto& entry : encoded) {
+        decode.time([&] {
+            if (!decodeRuns(entry.second.data(), entry.second.size(), entry.first, frame.data(), frame.size())) {
+                throw std::runtime_error("Frame store round trip failed");
+            }
+        });
+    }
+
+    auto rawBytes = encoded.size() * frame.size();
+    json properties = {
+        { "movie", movie.name },
+        { "frames", encoded.size() },
+        { "keyFrames", keyFrames },
+        { "rawBytes", rawBytes },
+        { "compressedBytes", compressedBytes },
+        { "ratio", (double) rawBytes / compressedBytes },
+    };
+    properties["benchmark"] = "frameStoreEncode";
+    results.push_back(encode.summarise(properties));
+    properties["benchmark"] = "frameStoreDecode";
+    results.push_back(decode.summarise(properties));
+}
+
+#ifdef __linux__
+/**
+ * An SPI bus in memory, which keeps the last message as spidev would hand it to the driver and counts what was sent.
+ */
+class MemorySpi : public Spi {
+    mutable std::vector<uint8_t> message;
+
+public:
+    mutable size_t bytes = 0;
+    mutable size_t messages = 0;
+
+    void write(const uint8_t *buffer, size_t length) const override {
+        message.assign(buffer, buffer + length);
+        bytes += length;
+        messages++;
+    }
+};
+
+/**
+ * A pin that reads high and ignores writes, so the panel always reports idle.
+ */
+class IdleGpio : public Gpio {
+protected:
+    void waitForEdge(int) const override {}
+
+public:
+    bool readValue() const override {
+        return true;
+    }
+
+    void writeValue(bool) const override {}
+};
+
+/**
+ * Pushes bitmaps through the e-paper driver over an in-memory SPI bus and idle pins, so what is timed is the refresh
+ * planning, window packing and command stream of EPaperDisplay::write. The driver still sleeps the 21ms its timing
+ * needs on every refresh, which refreshMs reports apart.
+ */
+void benchDisplayPush(json& results, const std::string& name, const Options& options,
+                      const std::vector<std::vector<uint8_t>>& bitmaps) {
+    auto spi = new MemorySpi();
+    EPaperDisplay display(options.display, {
+        .spi = std::unique_ptr<Spi>(spi),
+        .rst = std::unique_ptr<Gpio>(new IdleGpio()),
+        .dc = std::unique_ptr<Gpio>(new IdleGpio()),
+        .busy = std::unique_ptr<Gpio>(new IdleGpio()),
+    });
+    display.init();
+    spi->bytes = 0;
+    spi->messages = 0;
+
+    LatencyRecorder push;
+    int64_t refreshMs = 0;
+    auto refreshes = 0;
+    for (const auto& bitmap : bitmaps) {
+        push.time([&] { display.write(bitmap); });
+        refreshMs += display.getLastRefreshMs();
+        refreshes += display.getLastRefreshMs() > 0 ? 1 : 0;
+    }
+    results.push_back(push.summarise({
+        { "benchmark", "displayPush" },
+        { "movie", name },
+        { "refreshes", refreshes },
+        { "refreshMs", refreshes == 0 ? 0 : (double) refreshMs / refreshes },
+        { "spiBytesPerFrame", bitmaps.empty() ? 0 : (double) spi->bytes / bitmaps.size() },
+        { "spiMessagesPerFrame", bitmaps.empty() ? 0 : (double) spi->messages / bitmaps.size() },
+    }));
+}
+
+/**
+ * Pushes a noisy screen with a block moving across it, changed in full every PUSH_FULL_CHANGE_INTERVAL frames, so that
+ * the display push is measured without a movie to dither.
+ */
+void benchDisplayPushPattern(json& results, const std::string& workPath) {
+    std::mt19937 random(2);
+    std::vector<uint8_t> screen(EPD_WIDTH * EPD_HEIGHT / 8);
+    std::vector<std::vector<uint8_t>> bitmaps;
+    for (auto frame = 0; frame < PUSH_FRAMES; frame++) {
+        if (frame % PUSH_FULL_CHANGE_INTERVAL == 0) {
+            for (auto& byte : screen) {
+                byte = (uint8_t) random();
+            }
+        }
+        auto bitmap = screen;
+        const auto left = frame * 4 % (EPD_WIDTH / 8 - 8);
+        for (auto y = 100; y < 164; y++) {
+            std::fill_n(bitmap.begin() + y * EPD_WIDTH / 8 + left, 8, 0xFF);
+        }
+        bitmaps.push_back(bitmap);
+    }
+    benchDisplayPush(results, "pattern", getBenchOptions(workPath), bitmaps);
+}
+#endif
+
+/**
+ * Prepares every frame of the movie for count panels at once, each on its own thread with workers shared as vsmp
+ * shares them. benchPanels runs this in child processes so that their CPU time and peak memory are theirs alone.
+ */
+void playPanels(int count, const Movie& movie, const std::string& workPath) {
+    auto options = getBenchOptions(workPath);
+    PrefetchWorkers workers(options);
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < count; i++) {
+        threads.emplace_back([&] {
+            auto panelOptions = options;
+            PrefetchService prefetch(movie.path, getIndexPath(workPath, movie), nullptr, &panelOptions, EPD_WIDTH,
+                                     EPD_HEIGHT, AV_NOPTS_VALUE, -1, &workers);
+            PreparedFrame frame;
+            while (prefetch.tryTakeNext(frame)) {
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+pid_t startPanels(const BenchArguments& arguments, int count, const Movie& movie) {
+    auto countArgument = std::to_string(count);
+    auto pid = fork();
+    if (pid == 0) {
+        execlp(arguments.program.c_str(), arguments.program.c_str(), "--play-panels", countArgument.c_str(),
+               arguments.workPath.c_str(), movie.path.c_str(), (char *) nullptr);
+        _exit(127);
+    }
+    if (pid < 0) {
+        throw std::runtime_error("Cannot fork");
+    }
+    return pid;
+}
+
+/**
+ * Waits for a child started by startPanels, adding its CPU milliseconds and peak resident kilobytes to usage.
+ */
+void waitForPanels(pid_t pid, double& cpuMs, int64_t& maxRssKb) {
+    int status = 0;
+    struct rusage usage {};
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Panel benchmark process failed");
+    }
+    cpuMs += usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0
+             + usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+    maxRssKb += usage.ru_maxrss;
+}
+
+/**
+ * Plays the movie on several panels from one process and from a process per panel, as running several copies of
+ * vsmp would, comparing the CPU time and peak memory they take altogether.
+ */
+void benchPanels(json& results, const Movie& movie, const BenchArguments& arguments) {
+    for (auto count : PANEL_COUNTS) {
+        json summaries[2];
+        for (auto i = 0; i < 2; i++) {
+            auto oneProcess = i == 0;
+            auto start = std::chrono::steady_clock::now();
+            std::vector<pid_t> pids;
+            for (auto process = 0; process < (oneProcess ? 1 : count); process++) {
+                pids.push_back(startPanels(arguments, oneProcess ? count : 1, movie));
+            }
+            double cpuMs = 0;
+            int64_t maxRssKb = 0;
+            for (auto pid : pids) {
+                waitForPanels(pid, cpuMs, maxRssKb);
+            }
+            summaries[i] = {
+                { "benchmark", "panels" },
+                { "movie", movie.name },
+                { "panels", count },
+                { "processes", pids.size() },
+                { "wallMs", std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start).count() },
+                { "cpuMs", cpuMs },
+                { "maxRssKb", maxRssKb },
+            };
+        }
+
+        // Below 1 where one process is cheaper than a process per panel.
+        double separateCpuMs = summaries[1]["cpuMs"];
+        int64_t separateRssKb = summaries[1]["maxRssKb"];
+        summaries[0]["cpuRatio"] = separateCpuMs > 0 ? (double) summaries[0]["cpuMs"] / separateCpuMs : 0;
+        summaries[0]["memoryRatio"] = separateRssKb > 0 ? (double) summaries[0]["maxRssKb"] / separateRssKb : 0;
+        results.push_back(summaries[0]);
+        results.push_back(summaries[1]);
+    }
+}
+
+void benchMovie(json& results, const Movie& movie, const BenchArguments& arguments) {
+    std::cerr << "Benchmarking " << movie.name << std::endl;
+    auto options = getBenchOptions(arguments.workPath);
+
+    int64_t firstPts = 0;
+    int frames = 0;
+    auto decoded = benchDecode(results, movie, arguments.workPath, options, firstPts, frames);
+    benchSeek(results, movie, arguments.workPath, options, firstPts, frames, exactFrame);
+    benchSeek(results, movie, arguments.workPath, options, firstPts, frames, followingKeyframe);
+
+    VideoFormat format {};
+    {
+        FrameService frameService(movie.path, getIndexPath(arguments.workPath, movie), nullptr, &options);
+        format = frameService.getFormat();
+    }
+    auto bitmaps = benchDither(results, movie, format, options, decoded);
+    benchDitherScaling(results, movie, format, options, decoded);
+    benchFrameStore(results, movie, arguments.workPath, options);
+#ifdef __linux__
+    benchDisplayPush(results, movie.name, options, bitmaps);
+#endif
+    benchPanels(results, movie, arguments);
+
+    for (auto frame : decoded) {
+        av_frame_free(&frame);
+    }
+}
+
+void tryCreateDirectory(const std::string& path) {
+    if (mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0 && errno != EEXIST) {
+        std::stringstream ss;
+        ss << "Cannot create " << path;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+/**
+ * Benchmarks the playback hot paths on synthetic and any given movies, writing JSON results for regression tracking.
+ */
+int main(int argc, char *argv[]) {
+    if (argc == 5 && std::string(argv[1]) == "--play-panels") {
+        playPanels(std::stoi(argv[2]), { .name = argv[4], .path = argv[4] }, argv[3]);
+        return 0;
+    }
+
+    auto arguments = parseArguments(argc, argv);
+    tryCreateDirectory(arguments.workPath);
+
+    std::vector<Movie> movies;
+    if (arguments.synthetic) {
+        for (const auto& codec : CODECS) {
+            for (const auto& resolution : RESOLUTIONS) {
+                for (auto gopSize : GOP_SIZES) {
+                    // Every MJPEG frame is a keyframe whatever the GOP size.
+                    if (codec == "mjpeg" && gopSize != GOP_SIZES.front()) {
+                        continue;
+                    }
+                    SyntheticVideoSpec spec = {
+                        .codec = codec,
+                        .width = resolution.first,
+                        .height = resolution.second,
+                        .gopSize = gopSize,
+                        .frames = arguments.frames,
+                    };
+                    auto name = getSyntheticVideoName(spec);
+                    auto path = arguments.workPath + "/" + name + ".mkv";
+                    if (tryWriteSyntheticVideo(spec, path)) {
+                        movies.push_back({ .name = name, .path = path });
+                    } else {
+                        std::cerr << "Skipping " << name << ", no encoder" << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    for (const auto& path : arguments.movies) {
+        movies.push_back({ .name = path.substr(path.find_last_of('/') + 1), .path = path });
+    }
+
+    json results = json::array();
+    benchPack(results);
+#ifdef __linux__
+    benchDisplayPushPattern(results, arguments.workPath);
+#endif
+    for (const auto& movie : movies) {
+        benchMovie(results, movie, arguments);
+    }
+
+    json report = {
+        { "kernels", getPixelKernels().name },
+        { "hardwareConcurrency", std::thread::hardware_concurrency() },
+        { "results", results },
+    };
+    if (arguments.outPath.empty()) {
+        std::cout << report.dump(2) << std::endl;
+    } else {
+        std::ofstream file(arguments.outPath, std::ios_base::trunc);
+        file << report.dump(2) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "BakedMovie.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char BAKE_MAGIC[8] = { 'V', 'S', 'M', 'P', 'B', 'A', 'K', 'E' };
+const uint32_t BAKE_VERSION = 2;
+
+// Frames start on a page boundary, past the header.
+const uint64_t FRAMES_OFFSET = 4096;
+
+uint64_t getBakeKey(const std::string& moviePath, const Options& options, int screenWidth, int screenHeight) {
+    struct stat info {};
+    if (stat(moviePath.c_str(), &info) < 0) {
+        std::stringstream ss;
+        ss << "Cannot stat " << moviePath;
+        throw std::runtime_error(ss.str());
+    }
+
+    std::stringstream ss;
+    ss << info.st_size << ":" << info.st_mtime << ":"
+       << screenWidth << "x" << screenHeight << ":"
+       << options.width << "x" << options.height << "+" << options.offsetX << "+" << options.offsetY << ":"
+       << options.frameSkip << ":" << options.frameSkipMode << ":" << options.decoder.lowres << ":"
+       << options.scaler.quality << ":" << options.scaler.lumaFastPath << ":"
+       << options.dither.engine << ":" << options.dither.algorithm << ":"
+       << options.skip.nearBlackThreshold << ":" << options.skip.changeThreshold;
+    return hashString(ss.str());
+}
+
+BakeWriter::BakeWriter(const std::string& path, uint64_t key, int width, int height, uint32_t frameBytes)
+    : path(path), tempPath(path + ".tmp"), header(), encoder(KEY_FRAME_INTERVAL), offset(FRAMES_OFFSET) {
+    memcpy(header.magic, BAKE_MAGIC, sizeof(BAKE_MAGIC));
+    header.version = BAKE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.frameBytes = frameBytes;
+    header.key = key;
+
+    file.open(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::stringstream ss;
+        ss << "Cannot write to " << tempPath;
+        throw std::runtime_error(ss.str());
+    }
+    file.seekp(FRAMES_OFFSET);
+}
+
+void BakeWriter::append(const PreparedFrame& frame) {
+    if (frame.bitmap.size() != header.frameBytes) {
+        throw std::runtime_error("Frame does not match the bake geometry");
+    }
+
+    auto encoding = encoder.encode(frame.bitmap, encoded);
+    file.write((const char *) encoded.data(), encoded.size());
+    frames.push_back({ .pts = frame.pts, .offset = offset, .length = (uint32_t) encoded.size(), .encoding = encoding });
+    offset += encoded.size();
+}
+
+void BakeWriter::finish() {
+    // Align the table so it can be read in place.
+    auto padding = (alignof(BakedFrame) - offset % alignof(BakedFrame)) % alignof(BakedFrame);
+    file.write(std::string(padding, '\0').data(), padding);
+    offset += padding;
+
+    header.frameCount = frames.size();
+    header.tableOffset = offset;
+    file.write((const char *) frames.data(), frames.size() * sizeof(BakedFrame));
+    offset += frames.size() * sizeof(BakedFrame);
+
+    file.seekp(0);
+    file.write((const char *) &header, sizeof(header));
+    file.close();
+    if (file.fail()) {
+        std::stringstream ss;
+        ss << "Failed writing " << tempPath;
+        throw std::runtime_error(ss.str());
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) < 0) {
+        std::stringstream ss;
+        ss << "Cannot move " << tempPath << " to " << path;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+uint64_t BakeWriter::size() const {
+    return offset;
+}
+
+BakedMovie::BakedMovie(int fd, const uint8_t *data, size_t length)
+    : fd(fd), data(data), length(length), header((const BakeHeader *) data), next(0),
+      current(header->frameBytes), hasCurrent(false), currentIndex(0) {
+    frames = (const BakedFrame *) (data + header->tableOffset);
+}
+
+std::unique_ptr<BakedMovie> BakedMovie::tryOpen(const std::string& path, uint64_t key, int width, int height) {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < FRAMES_OFFSET) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto length = (size_t) info.st_size;
+    auto data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    // Checked before anything is sized or read from it, a bake cut short by a power cut can claim anything.
+    auto header = (const BakeHeader *) data;
+    auto valid = memcmp(header->magic, BAKE_MAGIC, sizeof(BAKE_MAGIC)) == 0
+        && header->version == BAKE_VERSION
+        && header->key == key
+        && header->width == (uint32_t) width
+        && header->height == (uint32_t) height
+        && header->frameBytes == (uint32_t) (width * height / 8)
+        && header->tableOffset >= FRAMES_OFFSET
+        && header->tableOffset <= length
+        && header->tableOffset % alignof(BakedFrame) == 0
+        && header->frameCount <= (length - header->tableOffset) / sizeof(BakedFrame);
+    if (!valid) {
+        munmap(data, length);
+        close(fd);
+        return nullptr;
+    }
+
+    madvise(data, length, MADV_SEQUENTIAL);
+    return std::unique_ptr<BakedMovie>(new BakedMovie(fd, (const uint8_t *) data, length));
+}
+
+BakedMovie::~BakedMovie() {
+    munmap((void *) data, length);
+    close(fd);
+}
+
+void BakedMovie::seekAfter(int64_t after) {
+    next = std::upper_bound(frames, frames + header->frameCount, after,
+                            [](int64_t value, const BakedFrame& frame) { return value < frame.pts; }) - frames;
+}
+
+void BakedMovie::decode(uint64_t index) {
+    const auto& frame = frames[index];
+    if (frame.offset < FRAMES_OFFSET || frame.offset > header->tableOffset
+        || frame.length > header->tableOffset - frame.offset
+        || !decodeRuns(data + frame.offset, frame.length, frame.encoding, current.data(), current.size())) {
+        std::stringstream ss;
+        ss << "Baked frame " << index << " is corrupt";
+        throw std::runtime_error(ss.str());
+    }
+    hasCurrent = true;
+    currentIndex = index;
+}
+
+bool BakedMovie::tryTakeNext(PreparedFrame& frame) {
+    if (next >= header->frameCount) {
+        return false;
+    }
+
+    // Deltas apply to the frame before, so after a seek replay them from the last key frame.
+    auto from = next;
+    if (!hasCurrent || currentIndex + 1 != next) {
+        while (from > 0 && frames[from].encoding != keyFrame) {
+            from--;
+        }
+    }
+    for (auto index = from; index <= next; index++) {
+        decode(index);
+    }
+
+    frame.pts = frames[next].pts;
+    frame.bitmap = current;
+    next++;
+    return true;
+}
+
+uint64_t BakedMovie::frameCount() const {
+    return header->frameCount;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../config/Config.h"
+#include "../prefetch/FrameSource.h"
+#include "FrameCodec.h"
+
+// Seeking replays at most this many delta frames, 5 seconds of 24 fps footage.
+const size_t KEY_FRAME_INTERVAL = 120;
+
+/**
+ * On disk layout of a baked movie: this header, encoded frames from FRAMES_OFFSET packed back to back, then a
+ * BakedFrame table entry for every frame. All integers are native endian, bakes are made on the unit that plays them.
+ */
+struct BakeHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameBytes;
+    uint64_t key;
+    uint64_t frameCount;
+    uint64_t tableOffset;
+};
+
+struct BakedFrame {
+    int64_t pts;
+    uint64_t offset;
+    uint32_t length;
+    FrameEncoding encoding;
+};
+
+/**
+ * Identifies the movie file and every option that changes which frames are shown or how they are dithered, a bake
+ * is only played back if its key matches.
+ */
+uint64_t getBakeKey(const std::string& moviePath, const Options& options, int screenWidth, int screenHeight);
+
+/**
+ * Writes a baked movie to a temporary file which is renamed into place once finished, so a bake is never half read.
+ */
+class BakeWriter {
+    std::string path;
+    std::string tempPath;
+    std::ofstream file;
+    BakeHeader header;
+    FrameEncoder encoder;
+    std::vector<uint8_t> encoded;
+    std::vector<BakedFrame> frames;
+    uint64_t offset;
+
+public:
+    BakeWriter(const std::string& path, uint64_t key, int width, int height, uint32_t frameBytes);
+
+    void append(const PreparedFrame& frame);
+    void finish();
+
+    /**
+     * @return bytes written so far.
+     */
+    uint64_t size() const;
+};
+
+/**
+ * A baked movie memory mapped for playback, frames are read straight from the page cache and only need their runs
+ * expanding rather than decoding and dithering.
+ */
+class BakedMovie : public FrameSource {
+    int fd;
+    const uint8_t *data;
+    size_t length;
+    const BakeHeader *header;
+    const BakedFrame *frames;
+    uint64_t next;
+
+    std::vector<uint8_t> current;
+    bool hasCurrent;
+    uint64_t currentIndex;
+
+    BakedMovie(int fd, const uint8_t *data, size_t length);
+    void decode(uint64_t index);
+
+public:
+    /**
+     * @return the baked movie at path, nullptr if there is none or it does not match key and the screen size.
+     */
+    static std::unique_ptr<BakedMovie> tryOpen(const std::string& path, uint64_t key, int width, int height);
+    ~BakedMovie() override;
+
+    /**
+     * Continues playback from the first frame after pts. Frames from the key frame before it are replayed on the next
+     * take.
+     */
+    void seekAfter(int64_t pts);
+
+    bool tryTakeNext(PreparedFrame& frame) override;
+
+    uint64_t frameCount() const;
+};
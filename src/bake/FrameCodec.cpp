@@ -0,0 +1,133 @@
+#include "FrameCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Shorter repeats are cheaper left inside a literal than split out into their own token.
+const size_t MIN_REPEAT = 3;
+
+void putToken(std::vector<uint8_t>& out, size_t count, bool repeat) {
+    auto value = ((uint64_t) (count - 1) << 1) | (repeat ? 1 : 0);
+    while (value >= 0x80) {
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+bool tryGetToken(const uint8_t *&encoded, const uint8_t *end, size_t& count, bool& repeat) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (encoded == end) {
+            return false;
+        }
+        auto byte = *encoded++;
+        value |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            repeat = value & 1;
+            count = (size_t) (value >> 1) + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void encodeRuns(const uint8_t *source, size_t length, std::vector<uint8_t>& out) {
+    size_t literal = 0;
+    size_t i = 0;
+    while (i < length) {
+        auto run = i + 1;
+        while (run < length && source[run] == source[i]) {
+            run++;
+        }
+
+        if (run - i < MIN_REPEAT) {
+            i = run;
+            continue;
+        }
+
+        if (literal < i) {
+            putToken(out, i - literal, false);
+            out.insert(out.end(), source + literal, source + i);
+        }
+        putToken(out, run - i, true);
+        out.push_back(source[i]);
+        i = literal = run;
+    }
+
+    if (literal < length) {
+        putToken(out, length - literal, false);
+        out.insert(out.end(), source + literal, source + length);
+    }
+}
+
+bool decodeRuns(const uint8_t *encoded, size_t encodedLength, FrameEncoding encoding, uint8_t *frame, size_t length) {
+    auto end = encoded + encodedLength;
+    size_t position = 0;
+    size_t count;
+    bool repeat;
+    while (encoded < end) {
+        if (!tryGetToken(encoded, end, count, repeat) || count > length - position) {
+            return false;
+        }
+
+        auto target = frame + position;
+        position += count;
+        if (repeat) {
+            if (encoded == end) {
+                return false;
+            }
+            auto value = *encoded++;
+            if (encoding == keyFrame) {
+                memset(target, value, count);
+            } else if (value != 0) {
+                for (size_t i = 0; i < count; i++) {
+                    target[i] ^= value;
+                }
+            }
+        } else {
+            if (count > (size_t) (end - encoded)) {
+                return false;
+            }
+            if (encoding == keyFrame) {
+                memcpy(target, encoded, count);
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    target[i] ^= encoded[i];
+                }
+            }
+            encoded += count;
+        }
+    }
+    return position == length;
+}
+
+FrameEncoder::FrameEncoder(size_t keyInterval) : keyInterval(std::max(keyInterval, (size_t) 1)), sinceKey(0) {}
+
+FrameEncoding FrameEncoder::encode(const std::vector<uint8_t>& frame, std::vector<uint8_t>& out) {
+    key.clear();
+    encodeRuns(frame.data(), frame.size(), key);
+
+    auto encoding = keyFrame;
+    if (sinceKey + 1 < keyInterval && previous.size() == frame.size()) {
+        delta.resize(frame.size());
+        for (size_t i = 0; i < frame.size(); i++) {
+            delta[i] = frame[i] ^ previous[i];
+        }
+
+        out.clear();
+        encodeRuns(delta.data(), delta.size(), out);
+        if (out.size() < key.size()) {
+            encoding = deltaFrame;
+        }
+    }
+
+    if (encoding == keyFrame) {
+        out.swap(key);
+        sinceKey = 0;
+    } else {
+        sinceKey++;
+    }
+    previous = frame;
+    return encoding;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Compression for 1bpp frames. A frame is stored either whole (a key frame) or as the XOR against the frame before
+ * it, which is mostly zero for video. Both are then run-length encoded as a sequence of tokens, each a LEB128 varint
+ * v: if v is odd the next byte repeats (v >> 1) + 1 times, otherwise (v >> 1) + 1 literal bytes follow.
+ */
+enum FrameEncoding : uint32_t { keyFrame, deltaFrame };
+
+/**
+ * Run-length encodes length bytes of source, appending to out.
+ */
+void encodeRuns(const uint8_t *source, size_t length, std::vector<uint8_t>& out);
+
+/**
+ * Decodes runs over a frame of length bytes: a key frame overwrites it, a delta frame is XORed into it so zero runs
+ * cost nothing.
+ * @return false if the encoded data is corrupt or does not cover exactly length bytes.
+ */
+bool decodeRuns(const uint8_t *encoded, size_t encodedLength, FrameEncoding encoding, uint8_t *frame, size_t length);
+
+/**
+ * Chooses the encoding for each frame in turn. A key frame is forced every keyInterval frames so that seeking never
+ * replays more than that, and is also used whenever it comes out smaller than the delta, e.g. on a cut.
+ */
+class FrameEncoder {
+    size_t keyInterval;
+    size_t sinceKey;
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> delta;
+    std::vector<uint8_t> key;
+
+public:
+    explicit FrameEncoder(size_t keyInterval);
+
+    /**
+     * Encodes frame into out, replacing its contents.
+     * @return how it was encoded.
+     */
+    FrameEncoding encode(const std::vector<uint8_t>& frame, std::vector<uint8_t>& out);
+};
@@ -1,15 +1,17 @@
 #include "Config.h"
+#include "StateJournal.h"
 
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 
 #include <pwd.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <dirent.h>
 
 std::string getHomePath() {
     const char *homedir;
@@ -23,6 +25,104 @@ std::string getHomePath() {
 
 using json = nlohmann::json;
 
+uint64_t hashString(const std::string& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto c : data) {
+        hash = (hash ^ (uint8_t) c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+DitherArithmetic parseDitherEngine(const std::string& value) {
+    if (value == "float") {
+        return floatingPoint;
+    }
+    if (value == "fixed") {
+        return fixedPoint;
+    }
+    std::stringstream ss;
+    ss << "Unknown dither engine " << value;
+    throw std::runtime_error(ss.str());
+}
+
+std::string ditherEngineName(DitherArithmetic engine) {
+    return engine == floatingPoint ? "float" : "fixed";
+}
+
+FrameSkipMode parseFrameSkipMode(const std::string& value) {
+    if (value == "exact") {
+        return exactFrame;
+    }
+    if (value == "keyframe") {
+        return followingKeyframe;
+    }
+    std::stringstream ss;
+    ss << "Unknown frame skip mode " << value;
+    throw std::runtime_error(ss.str());
+}
+
+std::string frameSkipModeName(FrameSkipMode mode) {
+    return mode == exactFrame ? "exact" : "keyframe";
+}
+
+DisplayBackend parseDisplayBackend(const std::string& value) {
+    if (value == "epaper") {
+        return ePaper;
+    }
+    if (value == "simulated") {
+        return simulated;
+    }
+    std::stringstream ss;
+    ss << "Unknown display backend " << value;
+    throw std::runtime_error(ss.str());
+}
+
+std::string displayBackendName(DisplayBackend backend) {
+    return backend == ePaper ? "epaper" : "simulated";
+}
+
+PlaybackMode parsePlaybackMode(const std::string& value) {
+    if (value == "frame-skip") {
+        return frameSkipPlayback;
+    }
+    if (value == "wall-clock") {
+        return wallClockPlayback;
+    }
+    std::stringstream ss;
+    ss << "Unknown playback mode " << value;
+    throw std::runtime_error(ss.str());
+}
+
+std::string playbackModeName(PlaybackMode mode) {
+    return mode == frameSkipPlayback ? "frame-skip" : "wall-clock";
+}
+
+const std::vector<std::string> SCALER_QUALITY_NAMES = { "fast-bilinear", "bilinear", "bicubic", "area", "lanczos" };
+
+ScalerQuality parseScalerQuality(const std::string& value) {
+    auto name = std::find(SCALER_QUALITY_NAMES.begin(), SCALER_QUALITY_NAMES.end(), value);
+    if (name == SCALER_QUALITY_NAMES.end()) {
+        std::stringstream ss;
+        ss << "Unknown scaler quality " << value;
+        throw std::runtime_error(ss.str());
+    }
+    return (ScalerQuality) (name - SCALER_QUALITY_NAMES.begin());
+}
+
+const std::vector<std::string> DITHER_ALGORITHM_NAMES = {
+    "floyd-steinberg", "atkinson", "sierra-lite", "bayer", "blue-noise"
+};
+
+DitherAlgorithm parseDitherAlgorithm(const std::string& value) {
+    auto name = std::find(DITHER_ALGORITHM_NAMES.begin(), DITHER_ALGORITHM_NAMES.end(), value);
+    if (name == DITHER_ALGORITHM_NAMES.end()) {
+        std::stringstream ss;
+        ss << "Unknown dither algorithm " << value;
+        throw std::runtime_error(ss.str());
+    }
+    return (DitherAlgorithm) (name - DITHER_ALGORITHM_NAMES.begin());
+}
+
 void tryCreateDirectories(const std::string& path) {
     if(access(path.c_str(), F_OK) < 0) {
         if (mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0) {
@@ -33,18 +133,151 @@ void tryCreateDirectories(const std::string& path) {
     }
 }
 
-Config::Config() :unSyncedUpdates(0) {
-    auto configDir = getHomePath();
+DisplayOptions parseDisplayOptions(const json& display, const DisplayOptions& defaults) {
+    return {
+        .backend = parseDisplayBackend(display.value("backend", displayBackendName(defaults.backend))),
+        .width = display.value("width", defaults.width),
+        .height = display.value("height", defaults.height),
+        .simulatedPath = display.value("simulatedPath", defaults.simulatedPath),
+        .simulateLatency = display.value("simulateLatency", defaults.simulateLatency),
+        .spiSpeed = display.value("spiSpeed", defaults.spiSpeed),
+        .busyTimeoutMs = display.value("busyTimeoutMs", defaults.busyTimeoutMs),
+        .partialRefresh = display.value("partialRefresh", defaults.partialRefresh),
+        .fullRefreshInterval = display.value("fullRefreshInterval", defaults.fullRefreshInterval),
+        .partialAreaPercent = display.value("partialAreaPercent", defaults.partialAreaPercent),
+        .spiDevice = display.value("spiDevice", defaults.spiDevice),
+        .rstPin = display.value("rstPin", defaults.rstPin),
+        .dcPin = display.value("dcPin", defaults.dcPin),
+        .busyPin = display.value("busyPin", defaults.busyPin),
+    };
+}
+
+json displayOptionsToJson(const DisplayOptions& display) {
+    return {
+        { "backend", displayBackendName(display.backend) },
+        { "width", display.width },
+        { "height", display.height },
+        { "simulatedPath", display.simulatedPath },
+        { "simulateLatency", display.simulateLatency },
+        { "spiSpeed", display.spiSpeed },
+        { "busyTimeoutMs", display.busyTimeoutMs },
+        { "partialRefresh", display.partialRefresh },
+        { "fullRefreshInterval", display.fullRefreshInterval },
+        { "partialAreaPercent", display.partialAreaPercent },
+        { "spiDevice", display.spiDevice },
+        { "rstPin", display.rstPin },
+        { "dcPin", display.dcPin },
+        { "busyPin", display.busyPin },
+    };
+}
+
+void validateDisplaySize(const std::string& name, const DisplayOptions& display) {
+    if (display.width <= 0 || display.width % 8 != 0 || display.height <= 0) {
+        std::stringstream ss;
+        ss << "Panel " << name << " is " << display.width << "x" << display.height
+           << ", it must have a width that is a multiple of 8";
+        throw std::runtime_error(ss.str());
+    }
+}
+
+/**
+ * Each panel plays its own movies on its own display, anything it does not set is taken from defaults. A simulated
+ * panel writes beside the default simulated path, suffixed with its name.
+ */
+std::vector<PanelOptions> parsePanels(const json& panels, const Options& defaults) {
+    std::vector<PanelOptions> result;
+    for (const auto& panel : panels) {
+        std::string name = panel.at("name");
+        if (name.empty() || name.find('/') != std::string::npos) {
+            std::stringstream ss;
+            ss << "Invalid panel name '" << name << "'";
+            throw std::runtime_error(ss.str());
+        }
+        for (const auto& other : result) {
+            if (other.name == name) {
+                std::stringstream ss;
+                ss << "Duplicate panel name " << name;
+                throw std::runtime_error(ss.str());
+            }
+        }
+
+        auto display = defaults.display;
+        display.simulatedPath = defaults.display.simulatedPath + "-" + name;
+
+        auto options = defaults;
+        options.path = panel.value("path", defaults.path);
+        options.display = parseDisplayOptions(panel.value("display", json::object()), display);
+
+        // A panel of another size plays across the whole of it unless it says otherwise.
+        auto resized = options.display.width != defaults.display.width
+            || options.display.height != defaults.display.height;
+        options.width = panel.value("width", resized ? options.display.width : defaults.width);
+        options.height = panel.value("height", resized ? options.display.height : defaults.height);
+        options.offsetX = panel.value("offsetX", resized ? 0 : defaults.offsetX);
+        options.offsetY = panel.value("offsetY", resized ? 0 : defaults.offsetY);
+        result.push_back({ .name = name, .options = options });
+    }
+
+    // Panels on the same chip select would talk over each other.
+    for (auto panel = result.begin(); panel != result.end(); panel++) {
+        validateDisplaySize(panel->name, panel->options.display);
+        for (auto other = result.begin(); other != panel; other++) {
+            if (panel->options.display.backend == ePaper && other->options.display.backend == ePaper
+                && panel->options.display.spiDevice == other->options.display.spiDevice) {
+                std::stringstream ss;
+                ss << "Panels " << other->name << " and " << panel->name << " are both on "
+                   << panel->options.display.spiDevice;
+                throw std::runtime_error(ss.str());
+            }
+        }
+    }
+    return result;
+}
+
+Config::Config() {
+    configDir = getHomePath();
     tryCreateDirectories(configDir);
 
-    std::stringstream stateStream;
-    stateStream << configDir << "/" << "state.json";
-    statePath = stateStream.str();
+    std::stringstream indexStream;
+    indexStream << configDir << "/" << "index";
+    indexPath = indexStream.str();
+    tryCreateDirectories(indexPath);
+
+    std::stringstream statsStream;
+    statsStream << configDir << "/" << "stats.json";
+    statsPath = statsStream.str();
+
+    std::stringstream bakeStream;
+    bakeStream << configDir << "/" << "baked";
+    bakePath = bakeStream.str();
+    tryCreateDirectories(bakePath);
 
     std::stringstream optionsStream;
     optionsStream << configDir << "/" << "options.json";
     auto optionsPath = optionsStream.str();
 
+    std::stringstream simulatedStream;
+    simulatedStream << configDir << "/" << "simulated";
+    auto simulatedPath = simulatedStream.str();
+
+    // The SPI device and pins are wired as on the Waveshare HAT.
+    DisplayOptions defaultDisplay = {
+        .backend = ePaper,
+        .width = 800,
+        .height = 480,
+        .simulatedPath = simulatedPath,
+        .simulateLatency = true,
+        .spiSpeed = 10000000,
+        .busyTimeoutMs = 30000,
+        .partialRefresh = true,
+        .fullRefreshInterval = 10,
+        .partialAreaPercent = 50,
+        .spiDevice = "/dev/spidev0.0",
+        .rstPin = 17,
+        .dcPin = 25,
+        .busyPin = 24,
+    };
+
     // Get options.
     if (access(optionsPath.c_str(), F_OK) == 0) {
         std::ifstream file(optionsStream.str());
@@ -52,6 +285,14 @@ Config::Config() :unSyncedUpdates(0) {
         file >> j;
         file.close();
 
+        // Options added after the first release are optional so that existing options.json files still load.
+        auto dither = j.value("dither", json::object());
+        auto decoder = j.value("decoder", json::object());
+        auto scaler = j.value("scaler", json::object());
+        auto skip = j.value("skip", json::object());
+        auto state = j.value("state", json::object());
+        auto playback = j.value("playback", json::object());
+
         options = {
             .path = j.at("path"),
             .width = j.at("width"),
@@ -59,13 +300,44 @@ Config::Config() :unSyncedUpdates(0) {
             .offsetX = j.at("offsetX"),
             .offsetY = j.at("offsetY"),
             .frameSkip = j.at("frameSkip"),
+            .frameSkipMode = parseFrameSkipMode(j.value("frameSkipMode", "exact")),
+            .playback = {
+                .mode = parsePlaybackMode(playback.value("mode", "frame-skip")),
+                .movieSecondsPerHour = playback.value("movieSecondsPerHour", 30.0),
+                .daysPerMovie = playback.value("daysPerMovie", 0.0),
+            },
+            .decoder = {
+                .lowres = decoder.value("lowres", true),
+                .threads = decoder.value("threads", 0),
+            },
+            .scaler = {
+                .quality = parseScalerQuality(scaler.value("quality", "lanczos")),
+                .lumaFastPath = scaler.value("lumaFastPath", true),
+            },
             .displaySeconds = j.at("displaySeconds"),
             .schedule = {
                 .enabled = j.at("schedule").at("enabled"),
                 .hourFrom = j.at("schedule").at("hourFrom"),
                 .hoursFor = j.at("schedule").at("hoursFor"),
-            }
+            },
+            .dither = {
+                .engine = parseDitherEngine(dither.value("engine", "float")),
+                .algorithm = parseDitherAlgorithm(dither.value("algorithm", "floyd-steinberg")),
+                .threads = dither.value("threads", 1),
+            },
+            .skip = {
+                .nearBlackThreshold = skip.value("nearBlackThreshold", 2),
+                .changeThreshold = skip.value("changeThreshold", 2),
+            },
+            .display = parseDisplayOptions(j.value("display", json::object()), defaultDisplay),
+            .state = {
+                .syncFrames = state.value("syncFrames", 10),
+                .syncSeconds = state.value("syncSeconds", 300),
+            },
+            .statsSeconds = j.value("statsSeconds", 60),
+            .panelWorkers = j.value("panelWorkers", 1),
         };
+        panels = parsePanels(j.value("panels", json::array()), options);
         // TODO validation
     } else {
         std::stringstream moviesStream;
@@ -78,8 +350,18 @@ Config::Config() :unSyncedUpdates(0) {
             .offsetX = 0,
             .offsetY = 0,
             .frameSkip = 1,
+            .frameSkipMode = exactFrame,
+            .playback = { .mode = frameSkipPlayback, .movieSecondsPerHour = 30, .daysPerMovie = 0 },
+            .decoder = { .lowres = true, .threads = 0 },
+            .scaler = { .quality = lanczosScaling, .lumaFastPath = true },
             .displaySeconds = 120,
             .schedule = { .enabled = false, .hourFrom = 8, .hoursFor = 14 },
+            .dither = { .engine = floatingPoint, .algorithm = floydSteinberg, .threads = 1 },
+            .skip = { .nearBlackThreshold = 2, .changeThreshold = 2 },
+            .display = defaultDisplay,
+            .state = { .syncFrames = 10, .syncSeconds = 300 },
+            .statsSeconds = 60,
+            .panelWorkers = 1,
         };
         std::ofstream file(optionsPath, std::ios_base::trunc);
         json j = {
@@ -89,105 +371,131 @@ Config::Config() :unSyncedUpdates(0) {
             { "offsetX", options.offsetX },
             { "offsetY", options.offsetY },
             { "frameSkip", options.frameSkip },
+            { "frameSkipMode", frameSkipModeName(options.frameSkipMode) },
+            { "playback", {
+                { "mode", playbackModeName(options.playback.mode) },
+                { "movieSecondsPerHour", options.playback.movieSecondsPerHour },
+                { "daysPerMovie", options.playback.daysPerMovie },
+            }},
+            { "decoder", {
+                { "lowres", options.decoder.lowres },
+                { "threads", options.decoder.threads },
+            }},
+            { "scaler", {
+                { "quality", SCALER_QUALITY_NAMES.at(options.scaler.quality) },
+                { "lumaFastPath", options.scaler.lumaFastPath },
+            }},
             { "displaySeconds", options.displaySeconds },
             { "schedule", {
                 { "enabled", options.schedule.enabled },
                 { "hourFrom", options.schedule.hourFrom },
                 { "hoursFor", options.schedule.hoursFor },
-            }}
+            }},
+            { "dither", {
+                { "engine", ditherEngineName(options.dither.engine) },
+                { "algorithm", DITHER_ALGORITHM_NAMES.at(options.dither.algorithm) },
+                { "threads", options.dither.threads },
+            }},
+            { "skip", {
+                { "nearBlackThreshold", options.skip.nearBlackThreshold },
+                { "changeThreshold", options.skip.changeThreshold },
+            }},
+            { "display", displayOptionsToJson(options.display) },
+            { "state", {
+                { "syncFrames", options.state.syncFrames },
+                { "syncSeconds", options.state.syncSeconds },
+            }},
+            { "statsSeconds", options.statsSeconds },
+            { "panelWorkers", options.panelWorkers },
         };
         file << j << std::endl;
         file.close();
     }
 
-    tryCreateDirectories(options.path);
-}
-
-void Config::setState(const State& state) {
-    std::ofstream file(statePath, std::ios_base::trunc);
-
-    json j = {
-        {"file", state.file},
-        {"pts", state.pts},
-    };
-
-    file << j << std::endl;
-    file.close();
-}
-
-std::unique_ptr<State> Config::getState() {
-    if (access(statePath.c_str(), F_OK) == 0) {
-        std::ifstream file(statePath);
-        json j;
-        file >> j;
-        file.close();
-
-        // TODO validation
-        std::unique_ptr<State> state(new State { .file = j.at("file"), .pts = j.at("pts") });
-        return state;
-    } else {
-        return nullptr;
+    // Without a panels list there is just the one, playing with the top level options.
+    if (panels.empty()) {
+        validateDisplaySize("", options.display);
+        panels.push_back({ .name = "", .options = options });
     }
-}
-
-std::vector<std::string> getMoviePaths(const std::string& path) {
-    static std::vector<std::string> extensions = { ".mp4", ".mkv", ".avi" };
-    std::vector<std::string> result;
-
-    auto dir = opendir(path.c_str());
-    if (!dir) {
-        std::stringstream ss;
-        ss << "Cannot open movie path " << path;
-        throw std::runtime_error(ss.str());
+    // Each movies path has one cache, named after the first panel playing from it unless that is the top level path.
+    for (const auto& panel : panels) {
+        tryCreateDirectories(panel.options.path);
+        if (libraryCachePaths.count(panel.options.path) == 0) {
+            std::stringstream ss;
+            ss << configDir << "/" << "library";
+            if (panel.options.path != options.path) {
+                ss << "-" << panel.name;
+            }
+            ss << ".json";
+            libraryCachePaths[panel.options.path] = ss.str();
+        }
     }
 
-    auto ent = readdir(dir);
-    while (ent) {
-        auto s = std::string(ent->d_name);
-        if (s.length() > 4 && std::find(extensions.begin(), extensions.end(), s.substr(s.length() - 4)) != extensions.end()) {
-            result.emplace_back(s);
+    // Carry over the state of versions that rewrote state.json, into the first panel.
+    std::stringstream stateStream;
+    stateStream << configDir << "/" << "state.json";
+    auto legacyStatePath = stateStream.str();
+    if (access(legacyStatePath.c_str(), F_OK) == 0) {
+        StateJournal journal(getJournalPath(panels.front().name));
+        if (!journal.getState()) {
+            try {
+                std::ifstream file(legacyStatePath);
+                json j;
+                file >> j;
+                journal.checkpoint({ .file = j.at("file"), .pts = j.at("pts"), .startedAt = time(nullptr) });
+            } catch (const json::exception& e) {
+                std::cerr << "Ignoring corrupt " << legacyStatePath << ": " << e.what() << std::endl;
+            }
+            unlink(legacyStatePath.c_str());
         }
-        ent = readdir(dir);
     }
-
-    closedir(dir);
-    return result;
 }
 
-std::unique_ptr<State> Config::setNextState() {
-    auto state = getState();
-    auto files = getMoviePaths(options.path);
-
-    std::stringstream pathStream;
-    pathStream << options.path << "/";
+std::string Config::getJournalPath(const std::string& name) const {
+    std::stringstream ss;
+    ss << configDir << "/" << "state";
+    if (!name.empty()) {
+        ss << "-" << name;
+    }
+    ss << ".journal";
+    return ss.str();
+}
 
-    if (state) {
-        auto file = std::find(files.begin(), files.end(), state->file);
-        if (file != files.end() && ++file != files.end()) {
-            pathStream << *file;
-            state->file = pathStream.str();
-            state->pts = -1;
-            setState(*state);
-            return state;
-        }
+Library& Config::getLibrary(const std::string& path) {
+    std::lock_guard<std::mutex> lock(librariesMutex);
+    auto& library = libraries[path];
+    if (!library) {
+        library.reset(new Library(path, libraryCachePaths.at(path)));
     }
+    return *library;
+}
+
+std::string Config::getCacheName(const std::string& file) const {
+    auto slash = file.find_last_of('/');
+    auto name = file.substr(slash + 1);
+    auto directory = slash == std::string::npos ? "" : file.substr(0, slash);
 
-    if (files.empty()) {
-        return nullptr;
+    // Movies in the top level path keep the names earlier versions gave them, those of other paths add a hash of it.
+    if (directory == options.path) {
+        return name;
     }
+    std::stringstream ss;
+    ss << name << "-" << std::hex << std::setw(16) << std::setfill('0') << hashString(directory);
+    return ss.str();
+}
 
-    pathStream << *files.begin();
-    std::unique_ptr<State> state0(new State { .file = pathStream.str(), .pts = -1 });
-    setState(*state0);
-    return state0;
+std::string Config::getIndexPath(const std::string& file) const {
+    std::stringstream ss;
+    ss << indexPath << "/" << getCacheName(file) << ".json";
+    return ss.str();
 }
 
-void Config::setPts(State& state, int64_t pts) {
-    state.pts = pts;
+std::string Config::getBakePath(const std::string& file) const {
+    std::stringstream ss;
+    ss << bakePath << "/" << getCacheName(file) << ".vsmpb";
+    return ss.str();
+}
 
-    // Every 10th frame, write the state to disc
-    if (++unSyncedUpdates % 10 == 0) {
-        unSyncedUpdates = 0;
-        setState(state);
-    }
+std::string Config::getStatsPath() const {
+    return statsPath;
 }
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <string>
 #include <optional>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include "../library/Library.h"
 
 struct Schedule {
     bool enabled;
@@ -10,6 +15,88 @@ struct Schedule {
     int hoursFor;
 };
 
+/**
+ * fixedPoint is an approximation of floatingPoint to opt into where the dither is too slow: it diffuses error in
+ * 1/4096ths of a GRAY16 level, so the odd pixel near the threshold can come out the other way.
+ */
+enum DitherArithmetic { floatingPoint, fixedPoint };
+
+enum DitherAlgorithm { floydSteinberg, atkinson, sierraLite, bayer, blueNoise };
+
+struct DitherOptions {
+    DitherArithmetic engine;
+    DitherAlgorithm algorithm;
+    int threads;
+};
+
+/**
+ * Frames are skipped rather than displayed when no part of them is brighter than nearBlackThreshold, or when no part
+ * has changed by changeThreshold or more since the last frame shown. Both are 8 bit levels averaged over a coarse
+ * grid, changeThreshold 0 disables change detection.
+ */
+struct SkipOptions {
+    int nearBlackThreshold;
+    int changeThreshold;
+};
+
+enum DisplayBackend { ePaper, simulated };
+
+struct DisplayOptions {
+    DisplayBackend backend;
+
+    /**
+     * Resolution of the panel, the width a multiple of 8. The movie area of the options is placed within it.
+     */
+    int width;
+    int height;
+    std::string simulatedPath;
+    bool simulateLatency;
+    int spiSpeed;
+    int busyTimeoutMs;
+    bool partialRefresh;
+    int fullRefreshInterval;
+    int partialAreaPercent;
+    std::string spiDevice;
+    int rstPin;
+    int dcPin;
+    int busyPin;
+};
+
+enum ScalerQuality { fastBilinearScaling, bilinearScaling, bicubicScaling, areaScaling, lanczosScaling };
+
+struct ScalerOptions {
+    ScalerQuality quality;
+    bool lumaFastPath;
+};
+
+struct DecoderOptions {
+    bool lowres;
+    int threads;
+};
+
+/**
+ * How often the playback position is synced to disk, whichever comes first. 0 turns a limit off, with both off every
+ * frame is synced.
+ */
+struct StateOptions {
+    int syncFrames;
+    int syncSeconds;
+};
+
+enum FrameSkipMode { exactFrame, followingKeyframe };
+
+enum PlaybackMode { frameSkipPlayback, wallClockPlayback };
+
+/**
+ * In wall clock playback the frame shown is the one due at the current time rather than the next after frameSkip,
+ * at movieSecondsPerHour or, if daysPerMovie is set, so that each movie lasts that long.
+ */
+struct PlaybackOptions {
+    PlaybackMode mode;
+    double movieSecondsPerHour;
+    double daysPerMovie;
+};
+
 struct Options {
     std::string path;
     int width;
@@ -17,28 +104,89 @@ struct Options {
     int offsetX;
     int offsetY;
     int frameSkip;
+    FrameSkipMode frameSkipMode;
+    PlaybackOptions playback;
+    DecoderOptions decoder;
+    ScalerOptions scaler;
     int displaySeconds;
     Schedule schedule;
+    DitherOptions dither;
+    SkipOptions skip;
+    DisplayOptions display;
+    StateOptions state;
+
+    /**
+     * How often playback metrics are written to stats.json, <= 0 to not write them at all.
+     */
+    int statsSeconds;
+
+    /**
+     * How many panels may decode and dither a frame at once.
+     */
+    int panelWorkers;
 };
 
-struct State {
-    std::string file;
-    int64_t pts;
+/**
+ * One display and the movies it plays. The name is empty when there is only the one panel.
+ */
+struct PanelOptions {
+    std::string name;
+    Options options;
 };
 
+/**
+ * FNV-1a, the same in every build and run, for naming and keying files on disk.
+ */
+uint64_t hashString(const std::string& data);
+
 class Config {
-    std::string statePath;
-    int unSyncedUpdates;
+    std::string configDir;
+    std::string indexPath;
+    std::string bakePath;
+    std::string statsPath;
+    std::map<std::string, std::string> libraryCachePaths;
+    std::map<std::string, std::unique_ptr<Library>> libraries;
+    std::mutex librariesMutex;
 
-    void setState(const State& state);
+    /**
+     * @return the name the index and bake of a movie file are kept under.
+     */
+    std::string getCacheName(const std::string& file) const;
 
 public:
+    /**
+     * Options from the top level of options.json, which every panel defaults to.
+     */
     Options options;
+    std::vector<PanelOptions> panels;
 
     Config();
 
-    std::unique_ptr<State> getState();
-    std::unique_ptr<State> setNextState();
-    void setPts(State& state, int64_t pts);
+    /**
+     * @return where the playback state of the panel called name is kept.
+     */
+    std::string getJournalPath(const std::string& name) const;
+
+    /**
+     * @return the movies in a panel's path, shared with any other panel playing from the same path. Only opened when
+     * first needed, so that baking a movie does not probe the whole library.
+     */
+    Library& getLibrary(const std::string& path);
+
+    /**
+     * @return where to persist the keyframe index of a movie file. Movies of the same name in different panel paths
+     * each have their own.
+     */
+    std::string getIndexPath(const std::string& file) const;
+
+    /**
+     * @return where to write the pre-dithered frames of a movie file, unique to its full path like the index.
+     */
+    std::string getBakePath(const std::string& file) const;
+
+    /**
+     * @return where to write playback metrics.
+     */
+    std::string getStatsPath() const;
 };
 
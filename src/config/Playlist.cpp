@@ -0,0 +1,74 @@
+#include "Playlist.h"
+
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+
+// Once their black frames are skipped, movies that are mostly black, such as blank recordings, would show next to
+// nothing for as long as they play.
+const double MAX_BLACK_FRAME_RATIO = 0.9;
+
+Playlist::Playlist(Config *config, PanelOptions *panel)
+    : config(config), panel(panel), unSyncedUpdates(0), lastSync(std::chrono::steady_clock::now()) {
+    journal.reset(new StateJournal(config->getJournalPath(panel->name)));
+}
+
+void Playlist::setState(const State& state) {
+    journal->checkpoint(state);
+    unSyncedUpdates = 0;
+    lastSync = std::chrono::steady_clock::now();
+}
+
+std::unique_ptr<State> Playlist::getState() {
+    return journal->getState();
+}
+
+std::unique_ptr<State> Playlist::setNextState() {
+    auto state = getState();
+
+    auto& library = config->getLibrary(panel->options.path);
+    library.update();
+    auto files = library.getPlayable(panel->options.skip.nearBlackThreshold > 0 ? MAX_BLACK_FRAME_RATIO : 1);
+
+    std::stringstream pathStream;
+    pathStream << panel->options.path << "/";
+
+    // Movies are in name order, so the next one follows by name even if the current one has since been removed.
+    if (state) {
+        auto name = state->file.substr(state->file.find_last_of('/') + 1);
+        auto file = std::upper_bound(files.begin(), files.end(), name);
+        if (file != files.end()) {
+            pathStream << *file;
+            state->file = pathStream.str();
+            state->pts = NOTHING_PLAYED;
+            state->startedAt = time(nullptr);
+            setState(*state);
+            return state;
+        }
+    }
+
+    if (files.empty()) {
+        return nullptr;
+    }
+
+    pathStream << *files.begin();
+    std::unique_ptr<State> state0(new State { .file = pathStream.str(), .pts = NOTHING_PLAYED, .startedAt = time(nullptr) });
+    setState(*state0);
+    return state0;
+}
+
+void Playlist::setPts(State& state, int64_t pts) {
+    state.pts = pts;
+
+    auto now = std::chrono::steady_clock::now();
+    auto syncFrames = panel->options.state.syncFrames;
+    auto syncSeconds = panel->options.state.syncSeconds;
+    auto sync = (syncFrames <= 0 && syncSeconds <= 0)
+        || (syncFrames > 0 && ++unSyncedUpdates >= syncFrames)
+        || (syncSeconds > 0 && now - lastSync >= std::chrono::seconds(syncSeconds));
+    if (sync) {
+        journal->append(pts);
+        unSyncedUpdates = 0;
+        lastSync = now;
+    }
+}
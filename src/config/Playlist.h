@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include "Config.h"
+#include "StateJournal.h"
+
+/**
+ * The movie a panel is playing and how far through it is, moving on through the movies in its path by name.
+ */
+class Playlist {
+    Config *config;
+    PanelOptions *panel;
+    std::unique_ptr<StateJournal> journal;
+    int unSyncedUpdates;
+    std::chrono::steady_clock::time_point lastSync;
+
+    void setState(const State& state);
+
+public:
+    Playlist(Config *config, PanelOptions *panel);
+
+    std::unique_ptr<State> getState();
+    std::unique_ptr<State> setNextState();
+    void setPts(State& state, int64_t pts);
+};
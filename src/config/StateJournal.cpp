@@ -0,0 +1,262 @@
+#include "StateJournal.h"
+
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const char JOURNAL_MAGIC[8] = { 'V', 'S', 'M', 'P', 'J', 'R', 'N', 'L' };
+const uint32_t JOURNAL_VERSION = 2;
+
+// Compact after 16 KB of records.
+const uint32_t MAX_JOURNAL_RECORDS = 1024;
+
+/**
+ * Followed by the movie file name. The checksum covers both.
+ */
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileLength;
+    int64_t pts;
+    int64_t startedAt;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+/**
+ * Header of version 1 journals, from before startedAt was kept.
+ */
+struct JournalHeaderV1 {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileLength;
+    int64_t pts;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+/**
+ * The sequence number is the record's index, so a record left over from before a torn write is never mistaken for
+ * the one that should be there.
+ */
+struct JournalRecord {
+    int64_t pts;
+    uint32_t sequence;
+    uint32_t crc;
+};
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> result(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            auto value = i;
+            for (auto bit = 0; bit < 8; bit++) {
+                value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+
+    auto bytes = (const uint8_t *) data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+template <class Header>
+uint32_t getHeaderCrc(const Header& header, const std::string& file) {
+    return crc32(file.data(), file.size(), crc32(&header, offsetof(Header, crc)));
+}
+
+uint32_t getRecordCrc(const JournalRecord& record) {
+    return crc32(&record, offsetof(JournalRecord, crc));
+}
+
+void writeAll(int fd, const void *data, size_t length, off_t offset, const std::string& path) {
+    auto bytes = (const uint8_t *) data;
+    while (length > 0) {
+        auto written = pwrite(fd, bytes, length, offset);
+        if (written < 0) {
+            std::stringstream ss;
+            ss << "Cannot write to " << path;
+            throw std::runtime_error(ss.str());
+        }
+        bytes += written;
+        length -= written;
+        offset += written;
+    }
+}
+
+bool tryReadAll(int fd, void *data, size_t length, off_t offset) {
+    return pread(fd, data, length, offset) == (ssize_t) length;
+}
+
+StateJournal::StateJournal(const std::string& path)
+    : path(path), tempPath(path + ".tmp"), fd(-1), recordsOffset(0), records(0) {
+    recover();
+}
+
+StateJournal::~StateJournal() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void StateJournal::recover() {
+    fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return;
+    }
+
+    // Checkpoints are only ever renamed into place whole, so a bad one is not ours.
+    struct stat info {};
+    JournalHeader header {};
+    if (fstat(fd, &info) < 0
+        || !tryReadAll(fd, &header, offsetof(JournalHeader, pts), 0)
+        || memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+        return;
+    }
+
+    // Version 1 did not keep startedAt, so its movie is taken as starting now. Records are the same in both.
+    auto legacy = header.version == 1;
+    JournalHeaderV1 legacyHeader {};
+    size_t headerLength;
+    if (legacy) {
+        headerLength = sizeof(legacyHeader);
+        if (!tryReadAll(fd, &legacyHeader, sizeof(legacyHeader), 0)) {
+            return;
+        }
+        header.pts = legacyHeader.pts;
+        header.startedAt = time(nullptr);
+    } else if (header.version == JOURNAL_VERSION) {
+        headerLength = sizeof(header);
+        if (!tryReadAll(fd, &header, sizeof(header), 0)) {
+            return;
+        }
+    } else {
+        return;
+    }
+    if (header.fileLength > info.st_size - headerLength) {
+        return;
+    }
+    std::string file(header.fileLength, '\0');
+    if (!tryReadAll(fd, &file[0], file.size(), headerLength)
+        || (legacy ? getHeaderCrc(legacyHeader, file) != legacyHeader.crc : getHeaderCrc(header, file) != header.crc)) {
+        return;
+    }
+
+    // Only the last record can be torn, so this rarely looks further back than one.
+    recordsOffset = headerLength + file.size();
+    auto pts = header.pts;
+    for (auto count = (info.st_size - recordsOffset) / sizeof(JournalRecord); count > 0; count--) {
+        JournalRecord record {};
+        if (tryReadAll(fd, &record, sizeof(record), recordsOffset + (count - 1) * sizeof(record))
+            && record.sequence == count - 1
+            && getRecordCrc(record) == record.crc) {
+            pts = record.pts;
+            records = (uint32_t) count;
+            break;
+        }
+    }
+
+    state.reset(new State { .file = file, .pts = pts, .startedAt = header.startedAt });
+
+    // Rewritten in the current version, so that startedAt is kept from now on.
+    if (legacy) {
+        checkpoint(*state);
+    }
+}
+
+std::unique_ptr<State> StateJournal::getState() const {
+    if (!state) {
+        return nullptr;
+    }
+    return std::unique_ptr<State>(new State(*state));
+}
+
+void StateJournal::checkpoint(const State& next) {
+    JournalHeader header {};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.fileLength = (uint32_t) next.file.size();
+    header.pts = next.pts;
+    header.startedAt = next.startedAt;
+    header.crc = getHeaderCrc(header, next.file);
+
+    auto tempFd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (tempFd < 0) {
+        std::stringstream ss;
+        ss << "Cannot write to " << tempPath;
+        throw std::runtime_error(ss.str());
+    }
+    try {
+        writeAll(tempFd, &header, sizeof(header), 0, tempPath);
+        writeAll(tempFd, next.file.data(), next.file.size(), sizeof(header), tempPath);
+    } catch (...) {
+        close(tempFd);
+        throw;
+    }
+    auto synced = fsync(tempFd) == 0;
+    close(tempFd);
+    if (!synced || rename(tempPath.c_str(), path.c_str()) < 0) {
+        std::stringstream ss;
+        ss << "Cannot move " << tempPath << " to " << path;
+        throw std::runtime_error(ss.str());
+    }
+
+    // The rename is only durable once the directory is synced.
+    auto directory = path.substr(0, path.find_last_of('/') + 1);
+    auto directoryFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        std::stringstream ss;
+        ss << "Cannot open " << path;
+        throw std::runtime_error(ss.str());
+    }
+
+    recordsOffset = sizeof(header) + next.file.size();
+    records = 0;
+    state.reset(new State(next));
+}
+
+void StateJournal::append(int64_t pts) {
+    if (!state) {
+        throw std::runtime_error("Cannot record a pts before a checkpoint");
+    }
+
+    state->pts = pts;
+    if (records >= MAX_JOURNAL_RECORDS) {
+        checkpoint(*state);
+        return;
+    }
+
+    JournalRecord record { .pts = pts, .sequence = records, .crc = 0 };
+    record.crc = getRecordCrc(record);
+
+    // Written at its slot rather than appended, which also overwrites anything torn from before a crash.
+    writeAll(fd, &record, sizeof(record), recordsOffset + records * sizeof(record), path);
+    if (fdatasync(fd) < 0) {
+        std::stringstream ss;
+        ss << "Cannot sync " << path;
+        throw std::runtime_error(ss.str());
+    }
+    records++;
+}
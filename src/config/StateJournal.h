@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * pts of a movie none of which has been played yet, the same value as libav's AV_NOPTS_VALUE. Streams may start at
+ * negative timestamps, so no real pts can stand in for it.
+ */
+const int64_t NOTHING_PLAYED = INT64_MIN;
+
+struct State {
+    std::string file;
+    int64_t pts;
+
+    /**
+     * Unix time the movie started playing, which wall clock playback is paced from.
+     */
+    int64_t startedAt;
+};
+
+/**
+ * Playback state kept as a checkpoint of the movie file followed by a record for every pts played since, each
+ * checksummed so that a write torn by a power cut is detected and the record before it used instead. Records are
+ * fixed size so the latest is found from the file size without reading the rest, and once there are enough of them
+ * the journal is compacted back to a single checkpoint. Checkpoints are written beside the journal and renamed over
+ * it, so there is always one complete journal on disk.
+ */
+class StateJournal {
+    std::string path;
+    std::string tempPath;
+    int fd;
+    std::unique_ptr<State> state;
+    uint64_t recordsOffset;
+    uint32_t records;
+
+    void recover();
+
+public:
+    explicit StateJournal(const std::string& path);
+    ~StateJournal();
+
+    /**
+     * @return the last state written, nullptr if there is none.
+     */
+    std::unique_ptr<State> getState() const;
+
+    /**
+     * Replaces the journal with one starting at state, for a new movie.
+     */
+    void checkpoint(const State& state);
+
+    /**
+     * Records that pts of the current movie has been played and syncs it to disk.
+     */
+    void append(int64_t pts);
+};
@@ -0,0 +1,42 @@
+#include "Display.h"
+
+#include <stdexcept>
+#include "SimulatedDisplay.h"
+#include "../epaper/EPaperDisplay.h"
+
+std::unique_ptr<Display> createDisplay(const DisplayOptions& options) {
+    switch (options.backend) {
+        case ePaper:
+#ifdef __linux__
+            return std::unique_ptr<Display>(new EPaperDisplay(options));
+#else
+            throw std::runtime_error("The e-paper backend needs Linux spidev and GPIO, use the simulated backend");
+#endif
+        case simulated:
+            return std::unique_ptr<Display>(new SimulatedDisplay(options));
+    }
+    throw std::runtime_error("Unknown display backend");
+}
+
+std::vector<uint8_t> createTestPattern(const Options& options) {
+    const auto width = options.display.width;
+    const auto height = options.display.height;
+    if (options.offsetX < 0 || options.width <= 0 || options.offsetX + options.width > width) {
+        throw std::runtime_error("invalid width");
+    }
+
+    if (options.offsetY < 0 || options.height <= 0 || options.offsetY + options.height > height) {
+        throw std::runtime_error("invalid height");
+    }
+
+    const auto pixels = height * width;
+    std::vector<uint8_t> buffer(pixels % 8 == 0 ? (pixels / 8) : (pixels / 8 + 1), 0);
+    for (auto y = options.offsetY; y < options.offsetY + options.height; y++) {
+        for (auto x = options.offsetX; x < options.offsetX + options.width; x++) {
+            auto i = y * width + x;
+            uint8_t bit = 7 - i % 8;
+            buffer.at(i / 8) |= 1UL << bit;
+        }
+    }
+    return buffer;
+}
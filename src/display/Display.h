@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "../config/Config.h"
+
+// The 7.5 inch panel, the only one the e-paper backend drives.
+const int EPD_WIDTH = 800;
+const int EPD_HEIGHT = 480;
+
+/**
+ * Somewhere to show DisplayOptions::width x height 1bpp frames.
+ */
+class Display {
+public:
+    virtual ~Display() = default;
+
+    virtual void init() = 0;
+
+    /**
+     * Shows a frame in the layout of DitherService::result, white pixels set.
+     */
+    virtual void write(std::vector<uint8_t> frame) = 0;
+
+    /**
+     * Shows the configured movie area as black on white, to line it up with a frame or mount.
+     */
+    virtual void writeTestPattern(const Options& options) = 0;
+
+    /**
+     * @return how long the last refresh took, 0 if the last write did not need one.
+     */
+    virtual int getLastRefreshMs() const = 0;
+};
+
+/**
+ * Creates the display backend configured in options.
+ */
+std::unique_ptr<Display> createDisplay(const DisplayOptions& options);
+
+/**
+ * @return a screen buffer the size of the display with the pixels of the configured movie area set.
+ */
+std::vector<uint8_t> createTestPattern(const Options& options);
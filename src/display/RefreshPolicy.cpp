@@ -0,0 +1,66 @@
+#include "RefreshPolicy.h"
+
+#include <algorithm>
+#include <cstring>
+
+DirtyWindow findDirtyWindow(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to, int width, int height) {
+    const auto rowBytes = width / 8;
+    DirtyWindow window = { .leftByte = rowBytes, .top = height, .rightByte = 0, .bottom = 0 };
+    for (auto y = 0; y < height; y++) {
+        auto a = from.data() + y * rowBytes;
+        auto b = to.data() + y * rowBytes;
+        if (memcmp(a, b, rowBytes) == 0) {
+            continue;
+        }
+
+        window.top = std::min(window.top, y);
+        window.bottom = y + 1;
+        auto left = 0;
+        while (a[left] == b[left]) {
+            left++;
+        }
+        auto right = rowBytes;
+        while (a[right - 1] == b[right - 1]) {
+            right--;
+        }
+        window.leftByte = std::min(window.leftByte, left);
+        window.rightByte = std::max(window.rightByte, right);
+    }
+
+    if (window.bottom == 0) {
+        window = { .leftByte = 0, .top = 0, .rightByte = 0, .bottom = 0 };
+    }
+    return window;
+}
+
+RefreshPolicy::RefreshPolicy(const DisplayOptions& options, int width, int height)
+    : options(options), width(width), height(height), partialsSinceFull(0) {}
+
+RefreshPlan RefreshPolicy::plan(const std::vector<uint8_t>& frame) const {
+    const DirtyWindow everything = { .leftByte = 0, .top = 0, .rightByte = width / 8, .bottom = height };
+    if (!options.partialRefresh || shown.size() != frame.size()
+        || partialsSinceFull >= options.fullRefreshInterval) {
+        return { .kind = refreshFull, .window = everything };
+    }
+
+    auto window = findDirtyWindow(shown, frame, width, height);
+    if (window.top == window.bottom) {
+        return { .kind = refreshNone, .window = window };
+    }
+
+    // Big changes look better with, and gain little from skipping, the full waveform.
+    auto area = (window.rightByte - window.leftByte) * 8 * (window.bottom - window.top);
+    if (area * 100 > width * height * options.partialAreaPercent) {
+        return { .kind = refreshFull, .window = everything };
+    }
+
+    return { .kind = refreshPartial, .window = window };
+}
+
+void RefreshPolicy::refreshed(const std::vector<uint8_t>& frame, const RefreshPlan& plan) {
+    if (plan.kind == refreshNone) {
+        return;
+    }
+    shown = frame;
+    partialsSinceFull = plan.kind == refreshFull ? 0 : partialsSinceFull + 1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../config/Config.h"
+
+/**
+ * Changed pixels between two frames, in whole bytes horizontally. Right and bottom are exclusive.
+ */
+struct DirtyWindow {
+    int leftByte;
+    int top;
+    int rightByte;
+    int bottom;
+};
+
+/**
+ * @return the bounding box of bytes that differ between two bitmaps of width x height pixels, with top == bottom if
+ * they are the same.
+ */
+DirtyWindow findDirtyWindow(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to, int width, int height);
+
+enum RefreshKind { refreshNone, refreshPartial, refreshFull };
+
+struct RefreshPlan {
+    RefreshKind kind;
+    DirtyWindow window;
+};
+
+/**
+ * Decides how to get each frame onto the panel given what is already shown: nothing if it is unchanged, a partial
+ * refresh of the changed window if that is small, otherwise or periodically a full refresh to clear ghosting.
+ */
+class RefreshPolicy {
+    DisplayOptions options;
+    int width;
+    int height;
+    std::vector<uint8_t> shown;
+    int partialsSinceFull;
+
+public:
+    RefreshPolicy(const DisplayOptions& options, int width, int height);
+
+    RefreshPlan plan(const std::vector<uint8_t>& frame) const;
+
+    /**
+     * Records that frame is now shown, having been refreshed as planned.
+     */
+    void refreshed(const std::vector<uint8_t>& frame, const RefreshPlan& plan);
+};
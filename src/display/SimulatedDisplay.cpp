@@ -0,0 +1,87 @@
+#include "SimulatedDisplay.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../metrics/Metrics.h"
+
+// Roughly how long the 7.5 inch panel is busy for each kind of refresh.
+const int FULL_REFRESH_MS = 4000;
+const int PARTIAL_REFRESH_MS = 400;
+
+SimulatedDisplay::SimulatedDisplay(const DisplayOptions& options)
+    : options(options), policy(options, options.width, options.height), lastRefreshMs(0) {}
+
+void SimulatedDisplay::init() {
+    if (mkdir(options.simulatedPath.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0 && errno != EEXIST) {
+        std::stringstream ss;
+        ss << "Cannot create simulated display directory " << options.simulatedPath;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+void SimulatedDisplay::write(std::vector<uint8_t> frame) {
+    lastRefreshMs = 0;
+    auto plan = policy.plan(frame);
+    if (plan.kind == refreshNone) {
+        return;
+    }
+
+    writePbm(frame);
+
+    const auto& window = plan.window;
+    auto bytes = (int64_t) (window.rightByte - window.leftByte) * (window.bottom - window.top);
+    auto transferMs = (int) (bytes * 8 * 1000 / options.spiSpeed);
+    lastRefreshMs = plan.kind == refreshFull ? FULL_REFRESH_MS : PARTIAL_REFRESH_MS;
+    if (options.simulateLatency) {
+        usleep((transferMs + lastRefreshMs) * 1000);
+    }
+    getMetrics().spiBytes.add(bytes);
+    getMetrics().spiTransfer.record((int64_t) transferMs * 1000000);
+    getMetrics().refresh.record((int64_t) lastRefreshMs * 1000000);
+
+    policy.refreshed(frame, plan);
+}
+
+void SimulatedDisplay::writeTestPattern(const Options& options) {
+    // The pattern is black on white, frames are white pixels set.
+    auto frame = createTestPattern(options);
+    for (auto& byte : frame) {
+        byte = ~byte;
+    }
+    write(frame);
+}
+
+int SimulatedDisplay::getLastRefreshMs() const {
+    return lastRefreshMs;
+}
+
+void SimulatedDisplay::writePbm(const std::vector<uint8_t>& frame) const {
+    std::stringstream pathStream;
+    pathStream << options.simulatedPath << "/" << "latest.pbm";
+    auto path = pathStream.str();
+    auto tempPath = path + ".tmp";
+
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::stringstream ss;
+        ss << "Cannot write to " << tempPath;
+        throw std::runtime_error(ss.str());
+    }
+
+    // Binary PBM rows are packed most significant bit first like ours, but 1 is black.
+    file << "P4\n" << options.width << " " << options.height << "\n";
+    for (auto byte : frame) {
+        file.put((char) ~byte);
+    }
+    file.close();
+
+    if (rename(tempPath.c_str(), path.c_str()) < 0) {
+        std::stringstream ss;
+        ss << "Cannot move " << tempPath << " to " << path;
+        throw std::runtime_error(ss.str());
+    }
+}
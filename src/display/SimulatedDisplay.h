@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include "Display.h"
+#include "RefreshPolicy.h"
+
+/**
+ * Stands in for the e-paper panel on machines without one. Each frame goes to latest.pbm in the configured directory,
+ * replaced atomically so a viewer never sees half a frame, and takes as long as the panel would to transfer and
+ * refresh it.
+ */
+class SimulatedDisplay : public Display {
+    DisplayOptions options;
+    RefreshPolicy policy;
+    int lastRefreshMs;
+
+    void writePbm(const std::vector<uint8_t>& frame) const;
+
+public:
+    explicit SimulatedDisplay(const DisplayOptions& options);
+
+    void init() override;
+    void write(std::vector<uint8_t> frame) override;
+    void writeTestPattern(const Options& options) override;
+    int getLastRefreshMs() const override;
+};
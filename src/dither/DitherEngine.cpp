@@ -0,0 +1,43 @@
+#include "DitherEngine.h"
+#include "ErrorDiffusion.h"
+#include "ThresholdDither.h"
+
+template <class Kernel, class T>
+DitherEngine* createErrorDiffusionEngine(const PixelKernels& kernels, int width, int height, WorkerPool *pool) {
+    if (pool && pool->concurrency() > 1) {
+        return new WavefrontDiffusionEngine<Kernel, T>(kernels, width, height, pool);
+    }
+    return new ErrorDiffusionEngine<Kernel, T>(kernels, width);
+}
+
+template <class Kernel>
+DitherEngine* createErrorDiffusionEngine(
+        DitherArithmetic arithmetic, const PixelKernels& kernels, int width, int height, WorkerPool *pool) {
+    if (arithmetic == fixedPoint) {
+        return createErrorDiffusionEngine<Kernel, int32_t>(kernels, width, height, pool);
+    }
+    return createErrorDiffusionEngine<Kernel, double>(kernels, width, height, pool);
+}
+
+std::unique_ptr<DitherEngine> createDitherEngine(
+        const DitherOptions& options, const PixelKernels& kernels, int width, int height, WorkerPool *pool) {
+    DitherEngine *engine;
+    switch (options.algorithm) {
+        case atkinson:
+            engine = createErrorDiffusionEngine<AtkinsonKernel>(options.engine, kernels, width, height, pool);
+            break;
+        case sierraLite:
+            engine = createErrorDiffusionEngine<SierraLiteKernel>(options.engine, kernels, width, height, pool);
+            break;
+        case bayer:
+            engine = new ThresholdEngine(kernels, width, BAYER_SIZE, getBayerThresholds(), pool);
+            break;
+        case blueNoise:
+            engine = new ThresholdEngine(kernels, width, BLUE_NOISE_SIZE, getBlueNoiseThresholds(), pool);
+            break;
+        default:
+            engine = createErrorDiffusionEngine<FloydSteinbergKernel>(options.engine, kernels, width, height, pool);
+            break;
+    }
+    return std::unique_ptr<DitherEngine>(engine);
+}
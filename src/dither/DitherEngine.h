@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "../config/Config.h"
+#include "PixelKernels.h"
+#include "../worker/WorkerPool.h"
+#include "../metrics/Metrics.h"
+
+/**
+ * A GRAY16 image and where its 1bpp dithered pixels go in the screen bitmap.
+ */
+struct DitherRegion {
+    const uint16_t *source;
+    int sourceLineSize;
+    int width;
+    int height;
+
+    uint8_t *bitmap;
+    int bitmapWidth;
+    int left;
+    int top;
+};
+
+class DitherEngine {
+protected:
+    const PixelKernels& kernels;
+    std::vector<uint8_t> pixels;
+
+    /**
+     * Packs the row of 0/1 pixels for row y of the region into the bitmap.
+     */
+    void pack(const DitherRegion& region, int y, const uint8_t *row) const {
+        ScopedTimer timer(getMetrics().pack);
+        packRow(kernels, row, region.width, region.bitmap, (region.top + y) * region.bitmapWidth + region.left);
+    }
+
+public:
+    DitherEngine(const PixelKernels& kernels, int width) : kernels(kernels), pixels(width) {}
+    virtual ~DitherEngine() = default;
+
+    /**
+     * Dithers the region to 1bpp, white pixels are set.
+     */
+    virtual void dither(const DitherRegion& region) = 0;
+};
+
+/**
+ * Creates the engine configured in options, sized for regions up to width x height pixels.
+ * @param pool Workers to spread each frame over, or nullptr to dither on the calling thread.
+ */
+std::unique_ptr<DitherEngine> createDitherEngine(
+        const DitherOptions& options, const PixelKernels& kernels, int width, int height, WorkerPool *pool);
@@ -1,13 +1,37 @@
 #include "DitherService.h"
 #include <algorithm>
+#include <chrono>
 #include <stdexcept>
+#include "../metrics/Metrics.h"
 
 extern "C" {
     #include <libavformat/avformat.h>
 }
 
-DitherService::DitherService(VideoFormat sourceFormat, Options* options, int screenWidth, int screenHeight)
-    : screenWidth(screenWidth), screenHeight(screenHeight) {
+int getSwsFlags(ScalerQuality quality) {
+    switch (quality) {
+        case fastBilinearScaling:
+            return SWS_FAST_BILINEAR;
+        case bilinearScaling:
+            return SWS_BILINEAR;
+        case bicubicScaling:
+            return SWS_BICUBIC;
+        case areaScaling:
+            return SWS_AREA;
+        case lanczosScaling:
+            break;
+    }
+    return SWS_LANCZOS | SWS_ACCURATE_RND;
+}
+
+int64_t getNanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+DitherService::DitherService(VideoFormat sourceFormat, Options* options, int screenWidth, int screenHeight,
+                             WorkerPool *sharedPool)
+    : screenWidth(screenWidth), screenHeight(screenHeight), kernels(getPixelKernels()), skip(options->skip),
+      signature(0, 0), lastSignature(0, 0), hasLastSignature(false), timings() {
 
     auto visibleHeight = options->height;
     auto visibleWidth = options->width;
@@ -23,15 +47,21 @@ DitherService::DitherService(VideoFormat sourceFormat, Options* options, int scr
     offsetY = options->offsetY + (visibleHeight - scaledHeight) / 2;
     offsetX = options->offsetX + (visibleWidth - scaledWidth) / 2;
 
-    swsContext = sws_getContext(
-            sourceFormat.width,
-            sourceFormat.height,
-            sourceFormat.pixelFormat,
-            scaledWidth,
-            scaledHeight,
-            AV_PIX_FMT_GRAY16,
-            SWS_LANCZOS | SWS_ACCURATE_RND,
-            nullptr, nullptr, nullptr);
+    // Downscaling YUV only needs luma, which is box filtered directly. swscale handles everything else.
+    swsContext = nullptr;
+    if (options->scaler.lumaFastPath && LumaScaler::supports(sourceFormat, scaledWidth, scaledHeight)) {
+        lumaScaler.reset(new LumaScaler(sourceFormat, scaledWidth, scaledHeight));
+    } else {
+        swsContext = sws_getContext(
+                sourceFormat.width,
+                sourceFormat.height,
+                sourceFormat.pixelFormat,
+                scaledWidth,
+                scaledHeight,
+                AV_PIX_FMT_GRAY16,
+                getSwsFlags(options->scaler.quality),
+                nullptr, nullptr, nullptr);
+    }
 
     scaledFrame = av_frame_alloc();
     scaledFrame->format = AV_PIX_FMT_GRAY16;
@@ -41,10 +71,22 @@ DitherService::DitherService(VideoFormat sourceFormat, Options* options, int scr
         throw std::exception();
     }
 
+    // Only the part of the scaled image that lands on the screen is dithered, the letterbox is always black.
+    clipLeft = std::max(0, -offsetX);
+    clipTop = std::max(0, -offsetY);
+    clipWidth = std::max(0, std::min(scaledWidth, screenWidth - offsetX) - clipLeft);
+    clipHeight = std::max(0, std::min(scaledHeight, screenHeight - offsetY) - clipTop);
+    signature = FrameSignature(clipWidth, clipHeight);
+    lastSignature = signature;
+
+    if (!sharedPool && options->dither.threads != 1) {
+        pool.reset(new WorkerPool(options->dither.threads));
+    }
+    engine = createDitherEngine(options->dither, kernels, clipWidth, clipHeight, sharedPool ? sharedPool : pool.get());
+
     const auto pixels = screenHeight * screenWidth;
-    data.resize(pixels);
     const auto resultSize = pixels % 8 == 0 ? (pixels / 8) : (pixels / 8 + 1);
-    result.resize(resultSize);
+    result.resize(resultSize, 0);
 }
 
 DitherService::~DitherService() {
@@ -52,82 +94,61 @@ DitherService::~DitherService() {
     av_frame_free(&scaledFrame);
 }
 
-bool DitherService::tryDitherNonEmpty(AVFrame *frame) {
-    if (sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height, scaledFrame->data, scaledFrame->linesize) < 0) {
+DitherOutcome DitherService::tryDither(AVFrame *frame) {
+    auto start = std::chrono::steady_clock::now();
+    if (lumaScaler) {
+        lumaScaler->scale(frame, (uint16_t*) scaledFrame->data[0], scaledFrame->linesize[0] / 2);
+    } else if (sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height, scaledFrame->data, scaledFrame->linesize) < 0) {
         throw std::runtime_error("Cannot scale frame");
     }
+    timings.scale = getNanosecondsSince(start);
+    start = std::chrono::steady_clock::now();
 
-    // Determine if the image is empty (all black)
+    // Determine if the image is empty (all black), which bails out on the first lit pixel of anything else.
     auto scaledData = (uint16_t*) scaledFrame->data[0];
-    auto allBlack = true;
-    auto scaledPixels = scaledWidth * scaledHeight;
-    for (auto p = scaledData; p < scaledData + scaledPixels; p++) {
-        if (*p > 0) {
-            allBlack = false;
-            break;
-        }
-    }
-
-    if (allBlack) {
-        return false;
-    }
-
-    // Copy grayscale image into a floating point representation ready for dithering
     const auto lineSize = scaledFrame->linesize[0] / 2;
-    for (auto y = 0; y < screenHeight; y++) {
-        auto scaledY = y - offsetY;
-        auto isScaledY = scaledY >= 0 && scaledY < scaledHeight;
-        for (auto x = 0; x < screenWidth; x++) {
-            auto scaledX = x - offsetX;
-            auto i = y * screenWidth + x;
-            data.at(i) = isScaledY && scaledX >= 0 && scaledX < scaledWidth
-                ? ((double) scaledData[scaledY * lineSize + scaledX]) / std::numeric_limits<uint16_t>::max()
-                : 0;
+    auto visibleData = scaledData + clipTop * lineSize + clipLeft;
+    auto outcome = frameBlack;
+    for (auto y = 0; y < clipHeight && outcome == frameBlack; y++) {
+        if (kernels.anyNonZero(visibleData + y * lineSize, clipWidth)) {
+            outcome = frameDithered;
         }
     }
 
-    // dither -> 1-bit via Floyd Steinberg https://en.wikipedia.org/wiki/Floyd%E2%80%93Steinberg_dithering
-    auto threshold = 0.5;
-    for (auto y = 0; y < screenHeight; y++) {
-        for (auto x = 0; x < screenWidth; x++) {
-            auto i = y * screenWidth + x;
-            auto oldPixel = data.at(i);
-            auto newPixel = data.at(i) = oldPixel > threshold ? 1.0 : 0;
-            auto error = oldPixel - newPixel;
-
-            if (x < screenWidth - 1) {
-                // pixel[x + 1][y    ] := pixel[x + 1][y    ] + quant_error * 7 / 16
-                data.at(y * screenWidth + x + 1) += error * 7 / 16;
-            }
-
-            if (y < screenHeight - 1) {
-                auto nextY = (y + 1) * screenWidth;
-                if (x > 0) {
-                    // pixel[x - 1][y + 1] := pixel[x - 1][y + 1] + quant_error * 3 / 16
-                    data.at(nextY + x - 1) += error * 3 / 16;
-                }
-
-                // pixel[x    ][y + 1] := pixel[x    ][y + 1] + quant_error * 5 / 16
-                data.at(nextY + x) += error * 5 / 16;
-
-                if (x < screenWidth - 1) {
-                    // pixel[x + 1][y + 1] := pixel[x + 1][y + 1] + quant_error * 1 / 16
-                    data.at(nextY + x + 1) += error / 16;
-                }
-            }
+    if (outcome == frameDithered) {
+        signature.compute(visibleData, lineSize);
+        if (signature.isBlack(skip.nearBlackThreshold)) {
+            outcome = frameBlack;
+        } else if (hasLastSignature && signature.difference(lastSignature) < skip.changeThreshold) {
+            outcome = frameUnchanged;
         }
     }
 
-    for (auto i = 0; i < data.size(); i++) {
-        uint8_t bit = 7 - i % 8;
-        if (data.at(i) > threshold) {
-            // set the bit
-            result.at(i / 8) |= 0x01u << bit;
-        } else {
-            // clear the bit
-            result.at(i / 8) &= ~(0x01u << bit);
-        }
-    }
+    timings.blackCheck = getNanosecondsSince(start);
+    timings.dither = 0;
+    getMetrics().scale.record(timings.scale);
+    getMetrics().blackCheck.record(timings.blackCheck);
 
-    return true;
+    if (outcome != frameDithered) {
+        return outcome;
+    }
+    std::swap(signature, lastSignature);
+    hasLastSignature = true;
+
+    DitherRegion region = {
+        .source = visibleData,
+        .sourceLineSize = lineSize,
+        .width = clipWidth,
+        .height = clipHeight,
+        .bitmap = result.data(),
+        .bitmapWidth = screenWidth,
+        .left = offsetX + clipLeft,
+        .top = offsetY + clipTop,
+    };
+    start = std::chrono::steady_clock::now();
+    engine->dither(region);
+    timings.dither = getNanosecondsSince(start);
+    getMetrics().dither.record(timings.dither);
+
+    return frameDithered;
 }
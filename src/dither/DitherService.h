@@ -3,12 +3,28 @@
 #include <vector>
 #include "../frame/VideoFormat.h"
 #include "../config/Config.h"
+#include "PixelKernels.h"
+#include "DitherEngine.h"
+#include "FrameSignature.h"
+#include "LumaScaler.h"
 
 extern "C" {
     #include <libavformat/avformat.h>
     #include <libswscale/swscale.h>
 }
 
+enum DitherOutcome { frameDithered, frameBlack, frameUnchanged };
+
+/**
+ * How long each stage of a tryDither call took, in nanoseconds. The black check includes the change detection and
+ * dithering includes packing to 1bpp.
+ */
+struct DitherTimings {
+    int64_t scale;
+    int64_t blackCheck;
+    int64_t dither;
+};
+
 class DitherService {
     SwsContext *swsContext;
     AVFrame *scaledFrame;
@@ -18,8 +34,18 @@ class DitherService {
     int offsetY;
     int scaledWidth;
     int scaledHeight;
-
-    std::vector<double> data;
+    int clipLeft;
+    int clipTop;
+    int clipWidth;
+    int clipHeight;
+    const PixelKernels& kernels;
+    SkipOptions skip;
+    FrameSignature signature;
+    FrameSignature lastSignature;
+    bool hasLastSignature;
+    std::unique_ptr<LumaScaler> lumaScaler;
+    std::unique_ptr<WorkerPool> pool;
+    std::unique_ptr<DitherEngine> engine;
 
 public:
     /**
@@ -27,13 +53,23 @@ public:
      */
     std::vector<uint8_t> result;
 
-    DitherService(VideoFormat sourceFormat, Options* options, int screenWidth, int screenHeight);
+    /**
+     * Stage timings of the last frame, dither is 0 if it was skipped.
+     */
+    DitherTimings timings;
+
+    /**
+     * @param sharedPool Threads to dither on shared with other panels, nullptr for a pool of its own if the options
+     * ask for more than one thread.
+     */
+    DitherService(VideoFormat sourceFormat, Options* options, int screenWidth, int screenHeight,
+                  WorkerPool *sharedPool);
     ~DitherService();
 
     /**
-     * Convert to a 1bpp bitmap.
+     * Convert to a 1bpp bitmap, unless it is (nearly) black or looks the same as the last frame dithered.
      * @param frame The frame to dither.
-     * @return true if the frame is non-black, false otherwise
+     * @return frameDithered if result now holds the frame, otherwise why it was skipped.
      */
-    bool tryDitherNonEmpty(AVFrame *frame);
+    DitherOutcome tryDither(AVFrame *frame);
 };
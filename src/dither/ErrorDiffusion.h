@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include "DitherEngine.h"
+#include "../worker/WorkerPool.h"
+
+/**
+ * Error diffusion arithmetic for each engine. Intensities are normalised so that white == 1.0 for the floating point
+ * engine and white == 65535 << ACCUMULATE_FRACTION_BITS (GRAY16 with fraction bits) for the fixed point engine.
+ */
+template <class T>
+struct Intensity;
+
+template <>
+struct Intensity<double> {
+    static constexpr double white = 1.0;
+    static constexpr double threshold = 0.5;
+
+    static void load(const PixelKernels& kernels, const uint16_t *values, int count, double *destination) {
+        kernels.accumulateNormalised(values, count, destination);
+    }
+
+    static double load(uint16_t value) {
+        return (double) value / std::numeric_limits<uint16_t>::max();
+    }
+
+    static double share(double error, int weight, int divisor) {
+        return error * weight / divisor;
+    }
+
+    static double remainder(double error, double, int weight, int divisor) {
+        return error * weight / divisor;
+    }
+};
+
+template <>
+struct Intensity<int32_t> {
+    static constexpr int32_t white = std::numeric_limits<uint16_t>::max() << ACCUMULATE_FRACTION_BITS;
+    static constexpr int32_t threshold = white / 2; // white is even, so v > threshold <=> v / white > 0.5
+
+    static void load(const PixelKernels& kernels, const uint16_t *values, int count, int32_t *destination) {
+        kernels.accumulate(values, count, destination);
+    }
+
+    static int32_t load(uint16_t value) {
+        return (int32_t) value << ACCUMULATE_FRACTION_BITS;
+    }
+
+    // Each share is truncated to within 1/4096 of a GRAY16 level of the floating point share and the remainder goes to
+    // the last neighbour, so the error is conserved exactly and no intensity is lost. This is not bit identical to the
+    // floating point engine, a pixel can still come out differently where that rounding tips it across the threshold.
+    static int32_t share(int32_t error, int weight, int divisor) {
+        return error * weight / divisor;
+    }
+
+    static int32_t remainder(int32_t error, int32_t given, int, int) {
+        return error - given;
+    }
+};
+
+/**
+ * Diffusion kernels. rows[0] is the current error row, rows[n] is n rows below, each padded by PADDING either side.
+ * reach is how far right the kernel diffuses along the current row, every kernel diffuses at most one pixel either
+ * side on the rows below.
+ */
+const int ERROR_DIFFUSION_PADDING = 2;
+
+// https://en.wikipedia.org/wiki/Floyd%E2%80%93Steinberg_dithering
+//     *  7
+//  3  5  1   / 16
+struct FloydSteinbergKernel {
+    static const int rows = 2;
+    static const int reach = 1;
+
+    template <class T>
+    static void diffuse(T error, T *const *rows, int x) {
+        typedef Intensity<T> I;
+        auto right = I::share(error, 7, 16);
+        auto belowLeft = I::share(error, 3, 16);
+        auto below = I::share(error, 5, 16);
+        rows[0][x + 1] += right;
+        rows[1][x - 1] += belowLeft;
+        rows[1][x] += below;
+        rows[1][x + 1] += I::remainder(error, right + belowLeft + below, 1, 16);
+    }
+};
+
+// Atkinson only diffuses 6/8 of the error, which gives more contrast at the cost of detail in highlights and shadows.
+//     *  1  1
+//  1  1  1
+//     1      / 8
+struct AtkinsonKernel {
+    static const int rows = 3;
+    static const int reach = 2;
+
+    template <class T>
+    static void diffuse(T error, T *const *rows, int x) {
+        auto share = Intensity<T>::share(error, 1, 8);
+        rows[0][x + 1] += share;
+        rows[0][x + 2] += share;
+        rows[1][x - 1] += share;
+        rows[1][x] += share;
+        rows[1][x + 1] += share;
+        rows[2][x] += share;
+    }
+};
+
+// https://en.wikipedia.org/wiki/Dither#Sierra_Lite
+//     *  2
+//  1  1      / 4
+struct SierraLiteKernel {
+    static const int rows = 2;
+    static const int reach = 1;
+
+    template <class T>
+    static void diffuse(T error, T *const *rows, int x) {
+        typedef Intensity<T> I;
+        auto right = I::share(error, 2, 4);
+        auto belowLeft = I::share(error, 1, 4);
+        rows[0][x + 1] += right;
+        rows[1][x - 1] += belowLeft;
+        rows[1][x] += I::remainder(error, right + belowLeft, 1, 4);
+    }
+};
+
+/**
+ * Streams the region one row at a time: convert, diffuse and pack, keeping only the error rows the kernel reaches.
+ * Error that would fall outside the region is dropped.
+ */
+template <class Kernel, class T>
+class ErrorDiffusionEngine : public DitherEngine {
+    int rowLength;
+    std::vector<T> errors;
+
+public:
+    ErrorDiffusionEngine(const PixelKernels& kernels, int width)
+        : DitherEngine(kernels, width), rowLength(width + 2 * ERROR_DIFFUSION_PADDING),
+          errors(Kernel::rows * rowLength) {}
+
+    void dither(const DitherRegion& region) override {
+        T *rows[Kernel::rows];
+        for (auto r = 0; r < Kernel::rows; r++) {
+            rows[r] = errors.data() + r * rowLength + ERROR_DIFFUSION_PADDING;
+        }
+        std::fill(errors.begin(), errors.end(), 0);
+
+        auto out = pixels.data();
+        for (auto y = 0; y < region.height; y++) {
+            auto current = rows[0];
+            Intensity<T>::load(kernels, region.source + y * region.sourceLineSize, region.width, current);
+            for (auto x = 0; x < region.width; x++) {
+                auto oldPixel = current[x];
+                auto isWhite = oldPixel > Intensity<T>::threshold;
+                out[x] = isWhite;
+                Kernel::diffuse(oldPixel - (isWhite ? Intensity<T>::white : 0), rows, x);
+            }
+            pack(region, y, out);
+
+            // Rotate the finished row to the bottom and clear it
+            std::rotate(rows, rows + 1, rows + Kernel::rows);
+            std::fill(current - ERROR_DIFFUSION_PADDING, current - ERROR_DIFFUSION_PADDING + rowLength, 0);
+        }
+    }
+};
+
+/**
+ * Error diffusion across several threads as a wavefront: row y + 1 runs behind row y, far enough that row y has
+ * finished every pixel that diffuses into the part of row y + 1 being worked on.
+ *
+ * Each row adds its source pixels just ahead of the kernel's reach, after the row above has diffused into them and
+ * before the row itself has, so every error cell sees its additions in the same order as the serial engine and the
+ * output is bit identical to ErrorDiffusionEngine for both arithmetics.
+ */
+template <class Kernel, class T>
+class WavefrontDiffusionEngine : public DitherEngine {
+    // Progress is published every PUBLISH_INTERVAL pixels to keep cache line traffic between cores down.
+    static const int PUBLISH_INTERVAL = 32;
+
+    // Pixels of a row that must be finished before the row below may work on pixel x is x + LAG.
+    static const int LAG = Kernel::reach + 2;
+
+    WorkerPool *pool;
+    int rowLength;
+    int slots;
+    std::vector<T> errors;
+    std::vector<uint8_t> slotPixels;
+    std::unique_ptr<std::atomic<int>[]> progress;
+    std::atomic<int> nextRow;
+
+    T *errorRow(int y) {
+        return errors.data() + (y % slots) * rowLength + ERROR_DIFFUSION_PADDING;
+    }
+
+    /**
+     * Waits until row y has finished at least pixels pixels, returning how many it has actually finished.
+     */
+    int waitForProgress(int y, int pixels) {
+        int done;
+        while ((done = progress[y].load(std::memory_order_acquire)) < pixels) {
+            std::this_thread::yield();
+        }
+        return done;
+    }
+
+    void ditherRow(const DitherRegion& region, int y) {
+        const auto width = region.width;
+
+        // The row furthest down we diffuse into is first touched by us, clear it once its previous user is done.
+        const auto lastRow = y + Kernel::rows - 1;
+        if (lastRow - slots >= 0) {
+            waitForProgress(lastRow - slots, width);
+        }
+        auto last = errorRow(lastRow);
+        std::fill(last - ERROR_DIFFUSION_PADDING, last - ERROR_DIFFUSION_PADDING + rowLength, 0);
+
+        T *rows[Kernel::rows];
+        for (auto r = 0; r < Kernel::rows; r++) {
+            rows[r] = errorRow(y + r);
+        }
+
+        auto current = rows[0];
+        auto source = region.source + y * region.sourceLineSize;
+        auto out = slotPixels.data() + (y % slots) * width;
+        auto above = y > 0 ? 0 : width;
+        auto loaded = 0;
+        for (auto x = 0; x < width; x++) {
+            const auto needed = std::min(x + LAG, width);
+            if (above < needed) {
+                above = waitForProgress(y - 1, needed);
+            }
+            for (const auto end = std::min(x + Kernel::reach, width - 1); loaded <= end; loaded++) {
+                current[loaded] += Intensity<T>::load(source[loaded]);
+            }
+
+            auto oldPixel = current[x];
+            auto isWhite = oldPixel > Intensity<T>::threshold;
+            out[x] = isWhite;
+            Kernel::diffuse(oldPixel - (isWhite ? Intensity<T>::white : 0), rows, x);
+
+            // Hold back the last publish until packed, so rows are packed in order and never race on a shared byte.
+            if (x % PUBLISH_INTERVAL == PUBLISH_INTERVAL - 1 && x < width - 1) {
+                progress[y].store(x + 1, std::memory_order_release);
+            }
+        }
+
+        pack(region, y, out);
+        progress[y].store(width, std::memory_order_release);
+    }
+
+public:
+    WavefrontDiffusionEngine(const PixelKernels& kernels, int width, int height, WorkerPool *pool)
+        : DitherEngine(kernels, 0), pool(pool), rowLength(width + 2 * ERROR_DIFFUSION_PADDING),
+          slots(pool->concurrency() + Kernel::rows), errors(slots * rowLength), slotPixels(slots * width),
+          progress(new std::atomic<int>[height]), nextRow(0) {}
+
+    void dither(const DitherRegion& region) override {
+        for (auto y = 0; y < region.height; y++) {
+            progress[y].store(0, std::memory_order_relaxed);
+        }
+        for (auto y = 0; y < Kernel::rows - 1; y++) {
+            auto row = errorRow(y);
+            std::fill(row - ERROR_DIFFUSION_PADDING, row - ERROR_DIFFUSION_PADDING + rowLength, 0);
+        }
+        nextRow.store(0);
+
+        // Rows are claimed in order by whichever threads are running, so any number of them make progress.
+        pool->parallelFor(pool->concurrency(), [this, &region](int) {
+            int y;
+            while ((y = nextRow.fetch_add(1)) < region.height) {
+                ditherRow(region, y);
+            }
+        });
+    }
+};
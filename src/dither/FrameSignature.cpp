@@ -0,0 +1,57 @@
+#include "FrameSignature.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Cells of roughly 25 x 20 pixels on the 800 x 480 panel.
+const int SIGNATURE_COLUMNS = 32;
+const int SIGNATURE_ROWS = 24;
+
+FrameSignature::FrameSignature(int width, int height)
+    : width(width), height(height),
+      columns(height > 0 ? std::min(width, SIGNATURE_COLUMNS) : 0),
+      rows(width > 0 ? std::min(height, SIGNATURE_ROWS) : 0),
+      cellColumns(width), rowStarts(rows + 1), divisors(columns * rows), sums(columns * rows), cells(columns * rows) {
+    for (auto x = 0; x < width; x++) {
+        cellColumns[x] = (int) ((int64_t) x * columns / width);
+    }
+    for (auto row = 1; row <= rows; row++) {
+        rowStarts[row] = (int) ((int64_t) row * height / rows);
+    }
+
+    // Pixels in each cell times 257, which divides a cell sum down to its mean in 8 bit levels.
+    for (auto row = 0; row < rows; row++) {
+        for (auto x = 0; x < width; x++) {
+            divisors[row * columns + cellColumns[x]] += (uint64_t) (rowStarts[row + 1] - rowStarts[row]) * 257;
+        }
+    }
+}
+
+void FrameSignature::compute(const uint16_t *source, int lineSize) {
+    std::fill(sums.begin(), sums.end(), 0);
+    for (auto row = 0; row < rows; row++) {
+        auto rowSums = sums.data() + row * columns;
+        for (auto y = rowStarts[row]; y < rowStarts[row + 1]; y++) {
+            auto line = source + y * lineSize;
+            for (auto x = 0; x < width; x++) {
+                rowSums[cellColumns[x]] += line[x];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < cells.size(); i++) {
+        cells[i] = (uint8_t) ((sums[i] + divisors[i] - 1) / divisors[i]);
+    }
+}
+
+bool FrameSignature::isBlack(int threshold) const {
+    return std::all_of(cells.begin(), cells.end(), [threshold](uint8_t cell) { return cell <= threshold; });
+}
+
+int FrameSignature::difference(const FrameSignature& other) const {
+    auto result = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+        result = std::max(result, std::abs((int) cells[i] - (int) other.cells[i]));
+    }
+    return result;
+}
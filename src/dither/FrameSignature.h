@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * A coarse picture of a GRAY16 image: the mean of each cell of a grid over it, in 8 bit levels rounded up so that only
+ * an all black cell is 0. It is cheap enough to work out for every frame, so frames that would not visibly change the
+ * panel are rejected before they are dithered.
+ */
+class FrameSignature {
+    int width;
+    int height;
+    int columns;
+    int rows;
+
+    /**
+     * Cell column of each image column and the image row each cell row starts at, with a final entry for the end.
+     */
+    std::vector<int> cellColumns;
+    std::vector<int> rowStarts;
+    std::vector<uint64_t> divisors;
+    std::vector<uint64_t> sums;
+    std::vector<uint8_t> cells;
+
+public:
+    FrameSignature(int width, int height);
+
+    void compute(const uint16_t *source, int lineSize);
+
+    /**
+     * @return true if no cell is brighter than threshold, so 0 only matches an all black image.
+     */
+    bool isBlack(int threshold) const;
+
+    /**
+     * @return the largest difference of any cell to the same cell of other, which must be the same size. A single
+     * cell catches a small moving subject that the mean over the whole frame would hide.
+     */
+    int difference(const FrameSignature& other) const;
+};
@@ -0,0 +1,87 @@
+#include "LumaScaler.h"
+
+#include <algorithm>
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
+
+bool isFullRange(AVPixelFormat format) {
+    switch (format) {
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_GRAY8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool LumaScaler::supports(const VideoFormat& source, int width, int height) {
+    auto descriptor = av_pix_fmt_desc_get(source.pixelFormat);
+    return descriptor
+        && !(descriptor->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL))
+        && descriptor->comp[0].plane == 0
+        && descriptor->comp[0].step == 1
+        && descriptor->comp[0].offset == 0
+        && descriptor->comp[0].shift == 0
+        && descriptor->comp[0].depth == 8
+        && width > 0 && height > 0
+        && width <= source.width && height <= source.height;
+}
+
+std::vector<int> getStarts(int sourceSize, int size) {
+    std::vector<int> starts(size + 1);
+    for (auto i = 0; i <= size; i++) {
+        starts[i] = (int) ((int64_t) i * sourceSize / size);
+    }
+    return starts;
+}
+
+LumaScaler::LumaScaler(const VideoFormat& source, int width, int height)
+    : sourceWidth(source.width), sourceHeight(source.height), width(width), height(height),
+      fullRange(isFullRange(source.pixelFormat)),
+      columnStarts(getStarts(source.width, width)), rowStarts(getStarts(source.height, height)),
+      minColumnCount(source.width / width), columnSums(source.width) {}
+
+void LumaScaler::scale(const AVFrame *frame, uint16_t *destination, int destinationLineSize) {
+    // Limited range luma is 16..235, like swscale stretch it to the full GRAY16 range.
+    auto full = fullRange || frame->color_range == AVCOL_RANGE_JPEG;
+    const int64_t black = full ? 0 : 16;
+    const int64_t range = full ? 255 : 219;
+
+    for (auto y = 0; y < height; y++) {
+        std::fill(columnSums.begin(), columnSums.end(), 0);
+        for (auto sourceY = rowStarts[y]; sourceY < rowStarts[y + 1]; sourceY++) {
+            auto row = frame->data[0] + sourceY * frame->linesize[0];
+            for (auto x = 0; x < sourceWidth; x++) {
+                columnSums[x] += row[x];
+            }
+        }
+
+        // Boxes are at most two widths, so there are only two divisions per row: sum * multiplier >> 32 scales the
+        // box sum to GRAY16.
+        const auto rowCount = rowStarts[y + 1] - rowStarts[y];
+        uint64_t multipliers[2];
+        for (auto i = 0; i < 2; i++) {
+            auto count = (int64_t) rowCount * (minColumnCount + i);
+            auto divisor = (uint64_t) (range * count);
+            multipliers[i] = (((uint64_t) 65535 << 32) + divisor - 1) / divisor;
+        }
+
+        auto out = destination + y * destinationLineSize;
+        for (auto x = 0; x < width; x++) {
+            auto from = columnStarts[x];
+            auto to = columnStarts[x + 1];
+            int64_t sum = 0;
+            for (auto sourceX = from; sourceX < to; sourceX++) {
+                sum += columnSums[sourceX];
+            }
+
+            auto value = sum - black * rowCount * (to - from);
+            auto scaled = value <= 0 ? 0 : ((uint64_t) value * multipliers[to - from - minColumnCount]) >> 32;
+            out[x] = (uint16_t) std::min(scaled, (uint64_t) 65535);
+        }
+    }
+}
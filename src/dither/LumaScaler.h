@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../frame/VideoFormat.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+/**
+ * Downscales the 8 bit luma plane of YUV and grey frames straight to GRAY16 with a box filter, skipping the colour
+ * conversion swscale would do for chroma we throw away. Each output pixel averages the block of source pixels that
+ * maps onto it, so an integer fraction of the source is an exact area average.
+ */
+class LumaScaler {
+    int sourceWidth;
+    int sourceHeight;
+    int width;
+    int height;
+    bool fullRange;
+
+    /**
+     * Source column/row each output column/row starts at, with a final entry for the end.
+     */
+    std::vector<int> columnStarts;
+    std::vector<int> rowStarts;
+    int minColumnCount;
+    std::vector<uint32_t> columnSums;
+
+public:
+    /**
+     * @return true if source frames can be scaled to width x height, which must not be larger than the source.
+     */
+    static bool supports(const VideoFormat& source, int width, int height);
+
+    LumaScaler(const VideoFormat& source, int width, int height);
+
+    void scale(const AVFrame *frame, uint16_t *destination, int destinationLineSize);
+};
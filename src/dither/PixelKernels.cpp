@@ -0,0 +1,106 @@
+#include "PixelKernels.h"
+
+#include <cstring>
+#include <limits>
+
+bool anyNonZeroScalar(const uint16_t *values, int count) {
+    for (auto p = values; p < values + count; p++) {
+        if (*p > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void accumulateScalar(const uint16_t *values, int count, int32_t *destination) {
+    for (auto i = 0; i < count; i++) {
+        destination[i] += (int32_t) values[i] << ACCUMULATE_FRACTION_BITS;
+    }
+}
+
+void accumulateNormalisedScalar(const uint16_t *values, int count, double *destination) {
+    for (auto i = 0; i < count; i++) {
+        destination[i] += (double) values[i] / std::numeric_limits<uint16_t>::max();
+    }
+}
+
+void packBytesScalar(const uint8_t *pixels, int bytes, uint8_t *bitmap) {
+    for (auto i = 0; i < bytes; i++, pixels += 8) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Each of the 8 bytes holds 0 or 1, the multiply moves pixel n to bit 63 - n without any carries.
+        uint64_t word;
+        memcpy(&word, pixels, sizeof(word));
+        bitmap[i] = (uint8_t) ((word * 0x8040201008040201ULL) >> 56u);
+#else
+        uint8_t byte = 0;
+        for (auto bit = 0; bit < 8; bit++) {
+            byte = (uint8_t) ((byte << 1u) | pixels[bit]);
+        }
+        bitmap[i] = byte;
+#endif
+    }
+}
+
+const PixelKernels SCALAR_KERNELS = {
+    .name = "scalar",
+    .anyNonZero = anyNonZeroScalar,
+    .accumulate = accumulateScalar,
+    .accumulateNormalised = accumulateNormalisedScalar,
+    .packBytes = packBytesScalar,
+};
+
+const PixelKernels& getScalarKernels() {
+    return SCALAR_KERNELS;
+}
+
+const PixelKernels* detectPixelKernels() {
+    const PixelKernels *kernels = nullptr;
+#if defined(__x86_64__) || defined(__i386__)
+    if (!(kernels = getAvx2Kernels())) {
+        kernels = getSse2Kernels();
+    }
+#endif
+#if defined(__ARM_NEON) || defined(__aarch64__)
+    kernels = getNeonKernels();
+#endif
+    return kernels ? kernels : &SCALAR_KERNELS;
+}
+
+const PixelKernels& getPixelKernels() {
+    static const PixelKernels *kernels = detectPixelKernels();
+    return *kernels;
+}
+
+void packRow(const PixelKernels& kernels, const uint8_t *pixels, int count, uint8_t *bitmap, int bitOffset) {
+    auto byte = bitmap + bitOffset / 8;
+    auto bit = 7 - bitOffset % 8;
+
+    // Bit at a time until we are byte aligned
+    for (; count > 0 && bit != 7; count--, pixels++) {
+        if (*pixels) {
+            *byte |= 0x01u << bit;
+        } else {
+            *byte &= ~(0x01u << bit);
+        }
+        if (--bit < 0) {
+            bit = 7;
+            byte++;
+        }
+    }
+
+    // Whole bytes
+    const auto bytes = count / 8;
+    kernels.packBytes(pixels, bytes, byte);
+    byte += bytes;
+    pixels += bytes * 8;
+    count -= bytes * 8;
+
+    // Remainder
+    for (; count > 0; count--, pixels++, bit--) {
+        if (*pixels) {
+            *byte |= 0x01u << bit;
+        } else {
+            *byte &= ~(0x01u << bit);
+        }
+    }
+}
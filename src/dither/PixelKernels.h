@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+// accumulate() gives GRAY16 values this many fraction bits, so the fixed point dither can diffuse fractions of a level.
+// Diffused error never exceeds half of white, so error * 7 / 16 is computed well within int32 at 12 bits.
+const int ACCUMULATE_FRACTION_BITS = 12;
+
+/**
+ * Hot per-pixel stages of the dither pipeline, implemented once in scalar code and again with whatever SIMD the
+ * CPU supports. Use getPixelKernels() to get the best implementation for the machine we are running on.
+ */
+struct PixelKernels {
+    const char *name;
+
+    /**
+     * @return true if any of the count values is non-zero.
+     */
+    bool (*anyNonZero)(const uint16_t *values, int count);
+
+    /**
+     * Widens count GRAY16 values to fixed point with ACCUMULATE_FRACTION_BITS and adds them to destination.
+     */
+    void (*accumulate)(const uint16_t *values, int count, int32_t *destination);
+
+    /**
+     * Normalises count GRAY16 values to 0..1 (value / 65535) and adds them to destination.
+     */
+    void (*accumulateNormalised)(const uint16_t *values, int count, double *destination);
+
+    /**
+     * Packs bytes * 8 pixels (each 0 or 1) into bytes of a 1bpp bitmap, most significant bit first.
+     */
+    void (*packBytes)(const uint8_t *pixels, int bytes, uint8_t *bitmap);
+};
+
+/**
+ * @return the fastest kernels supported by this CPU, detected on first call.
+ */
+const PixelKernels& getPixelKernels();
+
+/**
+ * @return the portable scalar kernels, the reference the SIMD kernels must match.
+ */
+const PixelKernels& getScalarKernels();
+
+/**
+ * Packs a row of count pixels (each 0 or 1) into a 1bpp bitmap starting at an arbitrary bit offset.
+ * Bits either side of the row are preserved.
+ */
+void packRow(const PixelKernels& kernels, const uint8_t *pixels, int count, uint8_t *bitmap, int bitOffset);
+
+#if defined(__x86_64__) || defined(__i386__)
+const PixelKernels* getSse2Kernels();
+const PixelKernels* getAvx2Kernels();
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+const PixelKernels* getNeonKernels();
+#endif
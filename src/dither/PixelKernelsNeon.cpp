@@ -0,0 +1,76 @@
+#include "PixelKernels.h"
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+bool anyNonZeroScalar(const uint16_t *values, int count);
+void accumulateScalar(const uint16_t *values, int count, int32_t *destination);
+void accumulateNormalisedScalar(const uint16_t *values, int count, double *destination);
+void packBytesScalar(const uint8_t *pixels, int bytes, uint8_t *bitmap);
+
+bool anyNonZeroNeon(const uint16_t *values, int count) {
+    auto i = 0;
+    // 32 pixels per iteration, branching once per 64 bytes
+    for (; i + 32 <= count; i += 32) {
+        auto any = vorrq_u16(
+                vorrq_u16(vld1q_u16(values + i), vld1q_u16(values + i + 8)),
+                vorrq_u16(vld1q_u16(values + i + 16), vld1q_u16(values + i + 24)));
+        auto folded = vorr_u16(vget_low_u16(any), vget_high_u16(any));
+        if (vget_lane_u64(vreinterpret_u64_u16(folded), 0) != 0) {
+            return true;
+        }
+    }
+    return anyNonZeroScalar(values + i, count - i);
+}
+
+void accumulateNeon(const uint16_t *values, int count, int32_t *destination) {
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto v = vld1q_u16(values + i);
+        auto d = destination + i;
+        auto low = vreinterpretq_s32_u32(vshll_n_u16(vget_low_u16(v), ACCUMULATE_FRACTION_BITS));
+        auto high = vreinterpretq_s32_u32(vshll_n_u16(vget_high_u16(v), ACCUMULATE_FRACTION_BITS));
+        vst1q_s32(d, vaddq_s32(vld1q_s32(d), low));
+        vst1q_s32(d + 4, vaddq_s32(vld1q_s32(d + 4), high));
+    }
+    accumulateScalar(values + i, count - i, destination + i);
+}
+
+void packBytesNeon(const uint8_t *pixels, int bytes, uint8_t *bitmap) {
+    // 0/1 shifted into bit 7 - n, then summing each group of 8 gives the packed byte
+    const int8_t shiftValues[8] = { 7, 6, 5, 4, 3, 2, 1, 0 };
+    const auto shifts = vcombine_s8(vld1_s8(shiftValues), vld1_s8(shiftValues));
+    auto i = 0;
+    for (; i + 2 <= bytes; i += 2) {
+        auto v = vshlq_u8(vld1q_u8(pixels + i * 8), shifts);
+        auto sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(v)));
+        bitmap[i] = (uint8_t) vgetq_lane_u64(sums, 0);
+        bitmap[i + 1] = (uint8_t) vgetq_lane_u64(sums, 1);
+    }
+    packBytesScalar(pixels + i * 8, bytes - i, bitmap + i);
+}
+
+// Armv7 NEON has no double precision lanes, the floating point engine stays on the scalar kernel.
+const PixelKernels NEON_KERNELS = {
+    .name = "neon",
+    .anyNonZero = anyNonZeroNeon,
+    .accumulate = accumulateNeon,
+    .accumulateNormalised = accumulateNormalisedScalar,
+    .packBytes = packBytesNeon,
+};
+
+const PixelKernels* getNeonKernels() {
+#if defined(__aarch64__)
+    return &NEON_KERNELS;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) ? &NEON_KERNELS : nullptr;
+#endif
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include "PixelKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <limits>
+
+// SSE2 is part of the x86-64 baseline, AVX2 is compiled per function and only used when the CPU reports it.
+#define AVX2 __attribute__((target("avx2")))
+
+bool anyNonZeroScalar(const uint16_t *values, int count);
+void accumulateScalar(const uint16_t *values, int count, int32_t *destination);
+void accumulateNormalisedScalar(const uint16_t *values, int count, double *destination);
+void packBytesScalar(const uint8_t *pixels, int bytes, uint8_t *bitmap);
+
+/**
+ * movemask gives pixel n in bit n, the bitmap wants it in bit 7 - n.
+ */
+struct ReversedBits {
+    uint8_t table[256];
+
+    ReversedBits() : table() {
+        for (auto i = 0; i < 256; i++) {
+            for (auto bit = 0; bit < 8; bit++) {
+                if (i & (0x01u << bit)) {
+                    table[i] |= 0x80u >> bit;
+                }
+            }
+        }
+    }
+};
+
+const ReversedBits REVERSED_BITS;
+
+bool anyNonZeroSse2(const uint16_t *values, int count) {
+    const auto zero = _mm_setzero_si128();
+    auto i = 0;
+    // 32 pixels per iteration, branching once per 64 bytes
+    for (; i + 32 <= count; i += 32) {
+        auto p = (const __m128i *) (values + i);
+        auto any = _mm_or_si128(
+                _mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, zero)) != 0xFFFF) {
+            return true;
+        }
+    }
+    return anyNonZeroScalar(values + i, count - i);
+}
+
+void accumulateSse2(const uint16_t *values, int count, int32_t *destination) {
+    const auto zero = _mm_setzero_si128();
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto v = _mm_loadu_si128((const __m128i *) (values + i));
+        auto d = (__m128i *) (destination + i);
+        auto low = _mm_slli_epi32(_mm_unpacklo_epi16(v, zero), ACCUMULATE_FRACTION_BITS);
+        auto high = _mm_slli_epi32(_mm_unpackhi_epi16(v, zero), ACCUMULATE_FRACTION_BITS);
+        _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), low));
+        _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), high));
+    }
+    accumulateScalar(values + i, count - i, destination + i);
+}
+
+void accumulateNormalisedSse2(const uint16_t *values, int count, double *destination) {
+    const auto zero = _mm_setzero_si128();
+    const auto white = _mm_set1_pd(std::numeric_limits<uint16_t>::max());
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto v = _mm_loadu_si128((const __m128i *) (values + i));
+        __m128i words[2] = { _mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero) };
+        for (auto w = 0; w < 2; w++) {
+            // Divide rather than multiply by the reciprocal to stay bit identical with the scalar kernel
+            auto d = destination + i + w * 4;
+            auto low = _mm_div_pd(_mm_cvtepi32_pd(words[w]), white);
+            auto high = _mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(words[w], 8)), white);
+            _mm_storeu_pd(d, _mm_add_pd(_mm_loadu_pd(d), low));
+            _mm_storeu_pd(d + 2, _mm_add_pd(_mm_loadu_pd(d + 2), high));
+        }
+    }
+    accumulateNormalisedScalar(values + i, count - i, destination + i);
+}
+
+void packBytesSse2(const uint8_t *pixels, int bytes, uint8_t *bitmap) {
+    auto i = 0;
+    for (; i + 2 <= bytes; i += 2) {
+        // 0/1 -> 0x00/0x80 so movemask picks up one bit per pixel
+        auto v = _mm_slli_epi16(_mm_loadu_si128((const __m128i *) (pixels + i * 8)), 7);
+        auto mask = (unsigned) _mm_movemask_epi8(v);
+        bitmap[i] = REVERSED_BITS.table[mask & 0xFFu];
+        bitmap[i + 1] = REVERSED_BITS.table[mask >> 8u];
+    }
+    packBytesScalar(pixels + i * 8, bytes - i, bitmap + i);
+}
+
+AVX2 bool anyNonZeroAvx2(const uint16_t *values, int count) {
+    auto i = 0;
+    // 64 pixels per iteration, branching once per 128 bytes
+    for (; i + 64 <= count; i += 64) {
+        auto p = (const __m256i *) (values + i);
+        auto any = _mm256_or_si256(
+                _mm256_or_si256(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1)),
+                _mm256_or_si256(_mm256_loadu_si256(p + 2), _mm256_loadu_si256(p + 3)));
+        if (!_mm256_testz_si256(any, any)) {
+            return true;
+        }
+    }
+    return anyNonZeroSse2(values + i, count - i);
+}
+
+AVX2 void accumulateAvx2(const uint16_t *values, int count, int32_t *destination) {
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto v = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (values + i))),
+                                   ACCUMULATE_FRACTION_BITS);
+        auto d = (__m256i *) (destination + i);
+        _mm256_storeu_si256(d, _mm256_add_epi32(_mm256_loadu_si256(d), v));
+    }
+    accumulateScalar(values + i, count - i, destination + i);
+}
+
+AVX2 void accumulateNormalisedAvx2(const uint16_t *values, int count, double *destination) {
+    const auto white = _mm256_set1_pd(std::numeric_limits<uint16_t>::max());
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto v = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) (values + i)));
+        auto d = destination + i;
+        _mm256_storeu_pd(d, _mm256_add_pd(_mm256_loadu_pd(d), _mm256_div_pd(_mm256_cvtepi32_pd(v), white)));
+    }
+    accumulateNormalisedScalar(values + i, count - i, destination + i);
+}
+
+AVX2 void packBytesAvx2(const uint8_t *pixels, int bytes, uint8_t *bitmap) {
+    // Reverse each group of 8 pixels so movemask lands pixel n of the group in bit 7 - n
+    const auto reverse = _mm256_setr_epi8(
+            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    auto i = 0;
+    for (; i + 4 <= bytes; i += 4) {
+        auto v = _mm256_loadu_si256((const __m256i *) (pixels + i * 8));
+        v = _mm256_slli_epi16(_mm256_shuffle_epi8(v, reverse), 7);
+        auto mask = (uint32_t) _mm256_movemask_epi8(v);
+        bitmap[i] = (uint8_t) mask;
+        bitmap[i + 1] = (uint8_t) (mask >> 8u);
+        bitmap[i + 2] = (uint8_t) (mask >> 16u);
+        bitmap[i + 3] = (uint8_t) (mask >> 24u);
+    }
+    packBytesSse2(pixels + i * 8, bytes - i, bitmap + i);
+}
+
+const PixelKernels SSE2_KERNELS = {
+    .name = "sse2",
+    .anyNonZero = anyNonZeroSse2,
+    .accumulate = accumulateSse2,
+    .accumulateNormalised = accumulateNormalisedSse2,
+    .packBytes = packBytesSse2,
+};
+
+const PixelKernels AVX2_KERNELS = {
+    .name = "avx2",
+    .anyNonZero = anyNonZeroAvx2,
+    .accumulate = accumulateAvx2,
+    .accumulateNormalised = accumulateNormalisedAvx2,
+    .packBytes = packBytesAvx2,
+};
+
+const PixelKernels* getSse2Kernels() {
+    return __builtin_cpu_supports("sse2") ? &SSE2_KERNELS : nullptr;
+}
+
+const PixelKernels* getAvx2Kernels() {
+    return __builtin_cpu_supports("avx2") ? &AVX2_KERNELS : nullptr;
+}
+
+#endif
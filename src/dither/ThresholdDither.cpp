@@ -0,0 +1,188 @@
+#include "ThresholdDither.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+ThresholdEngine::ThresholdEngine(const PixelKernels& kernels, int width, int tileSize, const std::vector<uint16_t>& thresholds,
+                                 WorkerPool *pool)
+    : DitherEngine(kernels, width * (pool ? pool->concurrency() : 1)), width(width), tileSize(tileSize),
+      thresholds(thresholds), pool(pool) {}
+
+void ThresholdEngine::dither(const DitherRegion& region) {
+    // Rows can be split into bands as long as no two rows share a byte of the bitmap: that is when every row starts on
+    // a byte boundary or there is at least a byte of letterbox between them.
+    const auto rowsByteAligned = region.bitmapWidth % 8 == 0 && region.left % 8 == 0;
+    const auto bands = pool && (rowsByteAligned || region.bitmapWidth - region.width >= 7)
+            ? std::min(pool->concurrency(), std::max(1, region.height))
+            : 1;
+
+    if (bands == 1) {
+        ditherRows(region, 0, region.height, pixels.data());
+        return;
+    }
+
+    pool->parallelFor(bands, [this, &region, bands](int band) {
+        ditherRows(region, region.height * band / bands, region.height * (band + 1) / bands,
+                   pixels.data() + band * width);
+    });
+}
+
+void ThresholdEngine::ditherRows(const DitherRegion& region, int from, int to, uint8_t *out) const {
+    const auto mask = tileSize - 1;
+    for (auto y = from; y < to; y++) {
+        auto source = region.source + y * region.sourceLineSize;
+        auto tile = thresholds.data() + (y & mask) * tileSize;
+        for (auto x = 0; x < region.width; x++) {
+            out[x] = source[x] > tile[x & mask];
+        }
+        pack(region, y, out);
+    }
+}
+
+/**
+ * Maps ranks 0..count-1 to evenly spaced GRAY16 thresholds, so a flat grey of v lights up ~v/65535 of the tile.
+ */
+std::vector<uint16_t> rankToThreshold(const std::vector<int>& ranks) {
+    const auto count = (int64_t) ranks.size();
+    std::vector<uint16_t> thresholds(ranks.size());
+    for (auto i = 0; i < (int) ranks.size(); i++) {
+        thresholds[i] = (uint16_t) ((2 * ranks[i] + 1) * std::numeric_limits<uint16_t>::max() / (2 * count));
+    }
+    return thresholds;
+}
+
+std::vector<uint16_t> createBayerThresholds() {
+    // B(2n) = | 4B(n)     4B(n) + 2 |
+    //         | 4B(n) + 3 4B(n) + 1 |
+    std::vector<int> ranks = { 0 };
+    for (auto size = 1; size < BAYER_SIZE; size *= 2) {
+        std::vector<int> next(4 * size * size);
+        for (auto y = 0; y < size; y++) {
+            for (auto x = 0; x < size; x++) {
+                auto value = 4 * ranks[y * size + x];
+                next[y * 2 * size + x] = value;
+                next[y * 2 * size + x + size] = value + 2;
+                next[(y + size) * 2 * size + x] = value + 3;
+                next[(y + size) * 2 * size + x + size] = value + 1;
+            }
+        }
+        ranks = next;
+    }
+    return rankToThreshold(ranks);
+}
+
+/**
+ * Gaussian energy of a binary pattern on a torus, the filter is truncated to a window as it is negligible beyond that.
+ */
+class VoidAndCluster {
+    static const int RADIUS = 8;
+    std::vector<float> filter;
+
+public:
+    std::vector<bool> pattern;
+    std::vector<float> energy;
+
+    VoidAndCluster() : filter((2 * RADIUS + 1) * (2 * RADIUS + 1)),
+        pattern(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE, false), energy(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE, 0) {
+        const auto sigma = 1.5f;
+        for (auto dy = -RADIUS; dy <= RADIUS; dy++) {
+            for (auto dx = -RADIUS; dx <= RADIUS; dx++) {
+                filter[(dy + RADIUS) * (2 * RADIUS + 1) + dx + RADIUS] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+            }
+        }
+    }
+
+    void set(int i, bool value) {
+        pattern[i] = value;
+        const auto sign = value ? 1.0f : -1.0f;
+        const auto mask = BLUE_NOISE_SIZE - 1;
+        for (auto dy = -RADIUS; dy <= RADIUS; dy++) {
+            auto row = ((i / BLUE_NOISE_SIZE + dy) & mask) * BLUE_NOISE_SIZE;
+            for (auto dx = -RADIUS; dx <= RADIUS; dx++) {
+                energy[row + ((i % BLUE_NOISE_SIZE + dx) & mask)] += sign * filter[(dy + RADIUS) * (2 * RADIUS + 1) + dx + RADIUS];
+            }
+        }
+    }
+
+    int tightestCluster() const {
+        auto best = -1;
+        for (auto i = 0; i < (int) pattern.size(); i++) {
+            if (pattern[i] && (best < 0 || energy[i] > energy[best])) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    int largestVoid() const {
+        auto best = -1;
+        for (auto i = 0; i < (int) pattern.size(); i++) {
+            if (!pattern[i] && (best < 0 || energy[i] < energy[best])) {
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+std::vector<uint16_t> createBlueNoiseThresholds() {
+    const auto pixels = BLUE_NOISE_SIZE * BLUE_NOISE_SIZE;
+
+    // Fixed seed so every player renders the same mask.
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> position(0, pixels - 1);
+
+    // Initial binary pattern: ~10% random points, relaxed by moving the tightest cluster into the largest void.
+    VoidAndCluster prototype;
+    auto ones = 0;
+    while (ones < pixels / 10) {
+        auto i = position(random);
+        if (!prototype.pattern[i]) {
+            prototype.set(i, true);
+            ones++;
+        }
+    }
+    // Converges long before this bound, it only guards against two points swapping forever.
+    for (auto iteration = 0; iteration < pixels; iteration++) {
+        auto cluster = prototype.tightestCluster();
+        prototype.set(cluster, false);
+        auto largestVoid = prototype.largestVoid();
+        prototype.set(largestVoid, true);
+        if (largestVoid == cluster) {
+            break;
+        }
+    }
+
+    std::vector<int> ranks(pixels);
+
+    // Phase 1: rank the initial points by removing the tightest cluster.
+    VoidAndCluster phase1 = prototype;
+    for (auto rank = ones - 1; rank >= 0; rank--) {
+        auto cluster = phase1.tightestCluster();
+        phase1.set(cluster, false);
+        ranks[cluster] = rank;
+    }
+
+    // Phase 2 & 3: rank the rest by filling the largest void. This skips the inverted phase 3 of the paper, which
+    // only changes the mask at the very brightest levels.
+    VoidAndCluster phase2 = prototype;
+    for (auto rank = ones; rank < pixels; rank++) {
+        auto largestVoid = phase2.largestVoid();
+        phase2.set(largestVoid, true);
+        ranks[largestVoid] = rank;
+    }
+
+    return rankToThreshold(ranks);
+}
+
+const std::vector<uint16_t>& getBayerThresholds() {
+    static const std::vector<uint16_t> thresholds = createBayerThresholds();
+    return thresholds;
+}
+
+const std::vector<uint16_t>& getBlueNoiseThresholds() {
+    static const std::vector<uint16_t> thresholds = createBlueNoiseThresholds();
+    return thresholds;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "DitherEngine.h"
+
+/**
+ * Ordered dithering against a tiled threshold map. There is no error carried between pixels, so every pixel (and row)
+ * is independent and far cheaper than error diffusion.
+ */
+class ThresholdEngine : public DitherEngine {
+    int width;
+    int tileSize;
+    const std::vector<uint16_t>& thresholds;
+    WorkerPool *pool;
+
+    void ditherRows(const DitherRegion& region, int from, int to, uint8_t *out) const;
+
+public:
+    /**
+     * @param thresholds tileSize * tileSize GRAY16 thresholds in row major order, tileSize must be a power of 2.
+     * @param pool Workers to split the rows over, or nullptr.
+     */
+    ThresholdEngine(const PixelKernels& kernels, int width, int tileSize, const std::vector<uint16_t>& thresholds,
+                    WorkerPool *pool);
+
+    void dither(const DitherRegion& region) override;
+};
+
+/**
+ * 8x8 Bayer matrix https://en.wikipedia.org/wiki/Ordered_dithering
+ */
+const std::vector<uint16_t>& getBayerThresholds();
+
+/**
+ * 64x64 blue noise mask generated once by void and cluster, http://cv.ulichney.com/papers/1993-void-cluster.pdf
+ */
+const std::vector<uint16_t>& getBlueNoiseThresholds();
+
+const int BAYER_SIZE = 8;
+const int BLUE_NOISE_SIZE = 64;
@@ -1,30 +1,54 @@
 #include "EPaperDisplay.h"
 
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <sstream>
 #include <iostream>
+#include <stdexcept>
+#include "../metrics/Metrics.h"
 
-const int EPD_RST_PIN = 17;
-const int EPD_DC_PIN = 25;
-const int EPD_BUSY_PIN = 24;
+// The controller may only update BUSY when asked for its status, so re-ask this often while waiting for an edge.
+const int STATUS_INTERVAL_MS = 100;
 
 void sleepMs(int ms) {
     usleep(ms * 1000);
 }
 
-EPaperDisplay::EPaperDisplay() {
-    rst = new Gpio(EPD_RST_PIN, out);
-    dc = new Gpio(EPD_DC_PIN, out);
-    busy = new Gpio(EPD_BUSY_PIN, in);
-    spi = new Spi("/dev/spidev0.0");
-    const auto pixels = EPD_HEIGHT * EPD_WIDTH;
-    screenBufferLength = pixels % 8 == 0 ? (pixels / 8) : (pixels / 8 + 1);
+const DisplayOptions& checkPanelSize(const DisplayOptions& options) {
+    if (options.width != EPD_WIDTH || options.height != EPD_HEIGHT) {
+        std::stringstream ss;
+        ss << "The e-paper backend only drives " << EPD_WIDTH << "x" << EPD_HEIGHT << " panels, not "
+           << options.width << "x" << options.height;
+        throw std::runtime_error(ss.str());
+    }
+    return options;
 }
 
-EPaperDisplay::~EPaperDisplay() {
-    delete rst;
-    delete dc;
-    delete busy;
-    delete spi;
+EPaperTransport openEPaperTransport(const DisplayOptions& options) {
+    // Each pin may wait on udev after export, so open them together.
+    auto openRst = std::async(std::launch::async, openGpio, options.rstPin, out);
+    auto openDc = std::async(std::launch::async, openGpio, options.dcPin, out);
+    auto openBusy = std::async(std::launch::async, openGpio, options.busyPin, in);
+    EPaperTransport transport;
+    transport.rst = openRst.get();
+    transport.dc = openDc.get();
+    transport.busy = openBusy.get();
+    transport.spi = openSpi(options.spiDevice, options.spiSpeed);
+    return transport;
+}
+
+EPaperDisplay::EPaperDisplay(const DisplayOptions& options)
+    : EPaperDisplay(options, openEPaperTransport(checkPanelSize(options))) {}
+
+EPaperDisplay::EPaperDisplay(const DisplayOptions& options, EPaperTransport transport)
+    : rst(std::move(transport.rst)), dc(std::move(transport.dc)), busy(std::move(transport.busy)),
+      spi(std::move(transport.spi)), options(checkPanelSize(options)), policy(options, EPD_WIDTH, EPD_HEIGHT),
+      lastRefreshMs(0) {
+    const auto pixels = EPD_HEIGHT * EPD_WIDTH;
+    screenBufferLength = pixels % 8 == 0 ? (pixels / 8) : (pixels / 8 + 1);
 }
 
 void EPaperDisplay::reset() {
@@ -37,11 +61,20 @@ void EPaperDisplay::reset() {
 }
 
 void EPaperDisplay::waitUntilIdle() {
-    do {
+    // BUSY is low while the panel is busy.
+    auto start = std::chrono::steady_clock::now();
+    sendCommand(0x71); //GET STATUS
+    while (!busy->waitForValue(true, STATUS_INTERVAL_MS)) {
+        auto waitedMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        if (waitedMs >= options.busyTimeoutMs) {
+            std::stringstream ss;
+            ss << "E-paper display still busy after " << waitedMs << "ms";
+            throw std::runtime_error(ss.str());
+        }
         sendCommand(0x71);
-        sleepMs(1);
-    } while (!busy->readValue());
-    sleepMs(200);
+    }
+    sleepMs(20);
 }
 
 void EPaperDisplay::sendCommand(uint8_t value) {
@@ -49,11 +82,10 @@ void EPaperDisplay::sendCommand(uint8_t value) {
     spi->writeByte(value);
 }
 
-void EPaperDisplay::sendData(uint8_t *buffer, int length) {
+void EPaperDisplay::sendData(const uint8_t *buffer, int length) {
+    ScopedTimer timer(getMetrics().spiTransfer);
     dc->writeValue(true);
-    for (auto p = buffer; p < buffer + length; p++) {
-        spi->writeByte(*p);
-    }
+    spi->write(buffer, length);
 }
 
 void EPaperDisplay::sendByte(uint8_t value) {
@@ -96,8 +128,12 @@ void EPaperDisplay::init() {
 
 void EPaperDisplay::turnOn() {
     sendCommand(0x12); //DISPLAY REFRESH
-    sleepMs(100); //!!! The delay here is necessary, 200uS at least!!!
+    auto start = std::chrono::steady_clock::now();
+    sleepMs(1); //!!! The delay here is necessary, 200uS at least!!!
     waitUntilIdle();
+    lastRefreshMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    getMetrics().refresh.recordSince(start);
 }
 
 void EPaperDisplay::clear() {
@@ -110,6 +146,7 @@ void EPaperDisplay::clear() {
     sendData(buffer.data(), screenBufferLength);
 
     turnOn();
+    policy.refreshed(buffer, { .kind = refreshFull, .window = { 0, 0, EPD_WIDTH / 8, EPD_HEIGHT } });
 }
 
 void EPaperDisplay::write(std::vector<uint8_t> frame) {
@@ -117,34 +154,75 @@ void EPaperDisplay::write(std::vector<uint8_t> frame) {
     for (auto i = 0; i < screenBufferLength; i++) {
         frame.at(i) = ~frame.at(i);
     }
+    lastRefreshMs = 0;
+
+    auto plan = policy.plan(frame);
+    switch (plan.kind) {
+        case refreshNone:
+            return;
+        case refreshPartial:
+            writePartial(frame, plan.window);
+            break;
+        case refreshFull:
+            writeFull(frame);
+            break;
+    }
+    policy.refreshed(frame, plan);
+}
+
+void EPaperDisplay::writeFull(const std::vector<uint8_t>& frame) {
     sendCommand(0x13);
     sendData(frame.data(), screenBufferLength);
     turnOn();
 }
 
-void EPaperDisplay::writeTestPattern(const Options& options) {
-    if (options.offsetX < 0 || options.width <= 0 || options.offsetX + options.width > EPD_WIDTH) {
-        throw std::runtime_error("invalid width");
+void EPaperDisplay::writePartial(const std::vector<uint8_t>& frame, const DirtyWindow& window) {
+    const auto rowBytes = EPD_WIDTH / 8;
+    const auto windowBytes = window.rightByte - window.leftByte;
+    std::vector<uint8_t> buffer(windowBytes * (window.bottom - window.top));
+    for (auto y = window.top; y < window.bottom; y++) {
+        auto row = frame.data() + y * rowBytes + window.leftByte;
+        std::copy(row, row + windowBytes, buffer.data() + (y - window.top) * windowBytes);
     }
 
-    if (options.offsetY < 0 || options.height <= 0 || options.offsetY + options.height > EPD_HEIGHT) {
-        throw std::runtime_error("invalid height");
-    }
+    const auto xStart = window.leftByte * 8;
+    const auto xEnd = window.rightByte * 8 - 1;
+    const auto yStart = window.top;
+    const auto yEnd = window.bottom - 1;
 
-    std::vector<uint8_t> buffer(screenBufferLength, 0);
-    for (auto y = options.offsetY; y < options.offsetY + options.height; y++) {
-        for (auto x = options.offsetX; x < options.offsetX + options.width; x++) {
-            auto i = y * EPD_WIDTH + x;
-            uint8_t bit = 7 - i % 8;
-            buffer.at(i / 8) |= 1UL << bit;
-        }
-    }
+    sendCommand(0X50); //VCOM AND DATA INTERVAL SETTING, floating border
+    sendByte(0xA9);
+    sendByte(0x07);
+
+    sendCommand(0x91); //PARTIAL IN
+    sendCommand(0x90); //PARTIAL WINDOW
+    sendByte(xStart >> 8);
+    sendByte(xStart & 0xFF);
+    sendByte(xEnd >> 8);
+    sendByte(xEnd & 0xFF);
+    sendByte(yStart >> 8);
+    sendByte(yStart & 0xFF);
+    sendByte(yEnd >> 8);
+    sendByte(yEnd & 0xFF);
+    sendByte(0x01); //scan inside and outside of the window
 
     sendCommand(0x13);
-    sendData(buffer.data(), screenBufferLength);
+    sendData(buffer.data(), (int) buffer.size());
     turnOn();
-}
-
 
+    sendCommand(0x92); //PARTIAL OUT
+    sendCommand(0X50);
+    sendByte(0x10);
+    sendByte(0x07);
+}
 
+void EPaperDisplay::writeTestPattern(const Options& options) {
+    auto buffer = createTestPattern(options);
+    sendCommand(0x13);
+    sendData(buffer.data(), screenBufferLength);
+    turnOn();
+}
 
+int EPaperDisplay::getLastRefreshMs() const {
+    return lastRefreshMs;
+}
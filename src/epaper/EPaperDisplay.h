@@ -1,31 +1,71 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include "../gpio/Gpio.h"
 #include "../spi/Spi.h"
 #include "../config/Config.h"
+#include "../display/Display.h"
+#include "../display/RefreshPolicy.h"
 
-const int EPD_WIDTH = 800;
-const int EPD_HEIGHT = 480;
+/**
+ * The SPI bus and GPIO pins an EPaperDisplay drives its panel through.
+ */
+struct EPaperTransport {
+    std::unique_ptr<Spi> spi;
+    std::unique_ptr<Gpio> rst, dc, busy;
+};
 
-class EPaperDisplay {
-    Gpio *rst, *dc, *busy;
-    Spi *spi;
+/**
+ * Opens the spidev device and pins named in options.
+ */
+EPaperTransport openEPaperTransport(const DisplayOptions& options);
+
+/**
+ * Waveshare 7.5 inch V2 panel on SPI.
+ */
+class EPaperDisplay : public Display {
+    std::unique_ptr<Gpio> rst, dc, busy;
+    std::unique_ptr<Spi> spi;
     int screenBufferLength;
+    DisplayOptions options;
+
+    /**
+     * Tracks what is on the panel, in panel polarity.
+     */
+    RefreshPolicy policy;
+    int lastRefreshMs;
 
     void reset();
     void waitUntilIdle();
     void sendCommand(uint8_t value);
     void sendByte(uint8_t value);
-    void sendData(uint8_t *buffer, int length);
+    void sendData(const uint8_t *buffer, int length);
+    void writeFull(const std::vector<uint8_t>& frame);
+    void writePartial(const std::vector<uint8_t>& frame, const DirtyWindow& window);
 
 public:
-    EPaperDisplay();
-    ~EPaperDisplay();
+    explicit EPaperDisplay(const DisplayOptions& options);
+
+    /**
+     * Drives the panel through transport rather than the hardware named in options, so that it can be benchmarked
+     * against a bus and pins in memory.
+     */
+    EPaperDisplay(const DisplayOptions& options, EPaperTransport transport);
 
-    void init();
+    void init() override;
     void turnOn();
     void clear();
-    void write(std::vector<uint8_t> frame);
-    void writeTestPattern(const Options& options);
-};
\ No newline at end of file
+
+    /**
+     * Shows the frame, refreshing only the window that changed since the last frame when that is small enough.
+     */
+    void write(std::vector<uint8_t> frame) override;
+    void writeTestPattern(const Options& options) override;
+
+    /**
+     * @return how long the panel was busy for the last refresh, 0 if the last write did not need one.
+     */
+    int getLastRefreshMs() const override;
+};
+
@@ -1,23 +1,31 @@
 #include "FrameService.h"
 
+#include <algorithm>
 #include <sstream>
 #include <iostream>
+#include <thread>
+#include "../metrics/Metrics.h"
 
-FrameService::FrameService(const std::string path) {
+FrameService::FrameService(const std::string& path, const std::string& indexPath, const MovieInfo *movie,
+                           Options *options)
+    : keyframesOnly(options->frameSkipMode == followingKeyframe), discardBefore(AV_NOPTS_VALUE) {
     // Open input file, and allocate format context
     if (avformat_open_input(&fmt_ctx, path.data(), nullptr, nullptr) < 0) {
         throw std::runtime_error("Could not open source file");
     }
 
-    // Retrieve stream information
-    if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
-        throw std::runtime_error("Could not find stream information");
-    }
-
     AVCodec *codec = nullptr;
-    video_stream_idx = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
-    if (video_stream_idx < 0) {
-        throw std::runtime_error("Could not find a video stream");
+    auto probed = movie && tryUseProbedStream(*movie, &codec);
+    if (!probed) {
+        // Retrieve stream information
+        if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
+            throw std::runtime_error("Could not find stream information");
+        }
+
+        video_stream_idx = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+        if (video_stream_idx < 0) {
+            throw std::runtime_error("Could not find a video stream");
+        }
     }
 
     // Allocate a codec context for the decoder
@@ -35,6 +43,8 @@ FrameService::FrameService(const std::string path) {
         throw std::runtime_error(ss.str());
     }
 
+    configureDecoder(codec, *options);
+
     // Init the decoder
     if (avcodec_open2(dec_ctx, codec, nullptr) < 0) {
         std::stringstream ss;
@@ -53,6 +63,23 @@ FrameService::FrameService(const std::string path) {
     pkt->data = nullptr;
     pkt->size = 0;
 
+    auto stream = fmt_ctx->streams[video_stream_idx];
+    timeBase = stream->time_base;
+    auto frameRate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+    if (probed) {
+        firstPts = movie->firstPts;
+        frameRate = AVRational { movie->frameRateNum, movie->frameRateDen };
+        durationSeconds = movie->durationSeconds;
+    } else {
+        firstPts = stream->start_time;
+        durationSeconds = stream->duration != AV_NOPTS_VALUE
+                ? stream->duration * av_q2d(timeBase)
+                : fmt_ctx->duration != AV_NOPTS_VALUE ? (double) fmt_ctx->duration / AV_TIME_BASE : 0;
+    }
+    startPts = firstPts != AV_NOPTS_VALUE ? firstPts : 0;
+    frameDuration = frameRate.num ? std::max((int64_t) 1, av_rescale_q(1, av_inv_q(frameRate), timeBase)) : 1;
+    loadIndex(path, indexPath);
+
     if (pkt->pos == -1 && !tryGetNextPacket()) {
         throw std::runtime_error("Could not read first packet");
     }
@@ -65,11 +92,147 @@ FrameService::~FrameService() {
     avcodec_close(dec_ctx);
 }
 
+/**
+ * Takes the video stream the library found when it probed the movie, as long as the header agrees with what it found.
+ * Headers that leave the size out, as some MPEG-TS do, still need the stream information read ahead for.
+ */
+bool FrameService::tryUseProbedStream(const MovieInfo& movie, AVCodec **codec) {
+    if (!movie.playable || movie.streamIndex < 0 || movie.streamIndex >= (int) fmt_ctx->nb_streams
+        || movie.pixelFormat == AV_PIX_FMT_NONE) {
+        return false;
+    }
+    auto parameters = fmt_ctx->streams[movie.streamIndex]->codecpar;
+    if (parameters->codec_type != AVMEDIA_TYPE_VIDEO || movie.codec != avcodec_get_name(parameters->codec_id)
+        || parameters->width != movie.width || parameters->height != movie.height) {
+        return false;
+    }
+
+    // Most headers leave the pixel format to be found by decoding the first frame, as reading ahead did.
+    if (parameters->format == AV_PIX_FMT_NONE) {
+        parameters->format = movie.pixelFormat;
+    }
+    *codec = avcodec_find_decoder(parameters->codec_id);
+    video_stream_idx = movie.streamIndex;
+    return *codec != nullptr;
+}
+
 VideoFormat FrameService::getFormat() {
-    VideoFormat format = { .width = dec_ctx->width, .height = dec_ctx->height, .pixelFormat = dec_ctx->pix_fmt };
+    // Decoded frames are reduced by lowres, rounding up.
+    auto parameters = fmt_ctx->streams[video_stream_idx]->codecpar;
+    VideoFormat format = {
+        .width = -((-parameters->width) >> dec_ctx->lowres),
+        .height = -((-parameters->height) >> dec_ctx->lowres),
+        .pixelFormat = dec_ctx->pix_fmt,
+    };
     return format;
 }
 
+// Frames with fewer pixels than this many panels decode fast enough on one thread.
+const int THREADED_DECODE_PANELS = 2;
+
+// Past 1/8 scale the decoder's IDCT shortcuts cost more quality than they save time.
+const int MAX_LOWRES = 3;
+
+void FrameService::configureDecoder(const AVCodec *codec, const Options& options) {
+    auto width = dec_ctx->width;
+    auto height = dec_ctx->height;
+
+    // Dithering scales the source by at most this much, see DitherService.
+    auto scale = std::max((double) options.width / width, (double) options.height / height);
+    if (options.decoder.lowres) {
+        auto lowres = 0;
+        while (lowres < std::min((int) codec->max_lowres, MAX_LOWRES) && scale * (1 << (lowres + 1)) <= 1) {
+            lowres++;
+        }
+        dec_ctx->lowres = lowres;
+    }
+
+    auto decodedPixels = (int64_t) (width >> dec_ctx->lowres) * (height >> dec_ctx->lowres);
+    auto threads = options.decoder.threads;
+    if (threads <= 0) {
+        threads = decodedPixels > (int64_t) THREADED_DECODE_PANELS * options.width * options.height
+                ? (int) std::max(1u, std::thread::hardware_concurrency())
+                : 1;
+    }
+
+    // libav uses frame threads where the codec has them, most streams are a single slice per frame.
+    dec_ctx->thread_count = threads;
+    dec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    std::cout << "Decoding " << width << "x" << height << " at 1/" << (1 << dec_ctx->lowres) << " scale on "
+              << threads << " thread(s)" << std::endl;
+}
+
+AVRational FrameService::getTimeBase() const {
+    return timeBase;
+}
+
+int64_t FrameService::getPtsAfter(int64_t pts, int frames) const {
+    return pts + frames * frameDuration;
+}
+
+int64_t FrameService::getFirstPts() const {
+    return firstPts;
+}
+
+// Rescaled exactly rather than through av_q2d, whose rounding adds up over hours of pts.
+int64_t FrameService::getPtsAt(int64_t position) const {
+    return startPts + av_rescale_q(position, AVRational { 1, AV_TIME_BASE }, timeBase);
+}
+
+int64_t FrameService::getPosition(int64_t pts) const {
+    return av_rescale_q(pts - startPts, timeBase, AVRational { 1, AV_TIME_BASE });
+}
+
+double FrameService::getDurationSeconds() const {
+    return durationSeconds;
+}
+
+void FrameService::loadIndex(const std::string& path, const std::string& indexPath) {
+    index.reset(new KeyframeIndex(path, video_stream_idx, timeBase));
+    if (index->tryLoad(indexPath)) {
+        return;
+    }
+
+    // Demux only, no decoding, so this is bound by reading the file once.
+    std::cout << "Building keyframe index for " << path << ", this might take a while" << std::endl;
+    std::vector<Keyframe> keyframes;
+    while (av_read_frame(fmt_ctx, pkt) >= 0) {
+        if (pkt->stream_index == video_stream_idx && (pkt->flags & AV_PKT_FLAG_KEY)) {
+            auto pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (pts != AV_NOPTS_VALUE) {
+                auto seekTimestamp = pkt->dts != AV_NOPTS_VALUE ? std::min(pkt->dts, pts) : pts;
+                keyframes.push_back({ .pts = pts, .seekTimestamp = seekTimestamp, .pos = pkt->pos });
+            }
+        }
+        av_packet_unref(pkt);
+    }
+
+    std::sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.pts < b.pts; });
+    for (const auto& keyframe : keyframes) {
+        index->add(keyframe);
+    }
+    index->save(indexPath);
+    std::cout << "Indexed " << index->size() << " keyframes" << std::endl;
+
+    // Back to the start for decoding
+    auto stream = fmt_ctx->streams[video_stream_idx];
+    auto start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (av_seek_frame(fmt_ctx, video_stream_idx, start, AVSEEK_FLAG_BACKWARD) < 0) {
+        throw std::runtime_error("Cannot rewind after building the keyframe index");
+    }
+}
+
+void FrameService::seekToKeyframe(const Keyframe& keyframe) {
+    // Some demuxers cannot seek by timestamp, byte position is the fallback.
+    if (av_seek_frame(fmt_ctx, video_stream_idx, keyframe.seekTimestamp, AVSEEK_FLAG_BACKWARD) < 0
+        && (keyframe.pos < 0 || av_seek_frame(fmt_ctx, video_stream_idx, keyframe.pos, AVSEEK_FLAG_BYTE) < 0)) {
+        throw std::runtime_error("Seek failed");
+    }
+    av_packet_unref(pkt);
+    avcodec_flush_buffers(dec_ctx);
+}
+
 bool FrameService::tryGetNextPacket() {
     while (av_read_frame(fmt_ctx, pkt) >= 0) {
         // check if the packet belongs to a stream we are interested in, otherwise skip it
@@ -78,6 +241,12 @@ bool FrameService::tryGetNextPacket() {
             continue;
         }
 
+        // Frames shown before the one we are seeking to are never displayed, so unless a later frame references them
+        // the decoder can drop them. AV_NOPTS_VALUE is INT64_MIN so nothing is discarded when not seeking.
+        dec_ctx->skip_frame = keyframesOnly
+                ? AVDISCARD_NONKEY
+                : pkt->pts != AV_NOPTS_VALUE && pkt->pts < discardBefore ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
         if (avcodec_send_packet(dec_ctx, pkt) < 0) {
             std::cerr << "Error decoding packet" << std::endl;
             av_packet_unref(pkt);
@@ -101,12 +270,16 @@ bool FrameService::tryGetNextFrame() {
                 return false;
             default:
                 // Skip the rest of this packet on error
+                if (ret >= 0 && frame->pts == AV_NOPTS_VALUE) {
+                    frame->pts = frame->best_effort_timestamp;
+                }
                 return ret >= 0;
         }
     }
 }
 
 bool FrameService::tryGetNext(AVFrame **result) {
+    ScopedTimer timer(getMetrics().decode);
     while (!tryGetNextFrame()) {
         av_packet_unref(pkt);
         if (!tryGetNextPacket()) {
@@ -122,6 +295,7 @@ bool FrameService::tryGetNext(AVFrame **result) {
 }
 
 bool FrameService::trySeek(int64_t pts, AVFrame **result) {
+    ScopedTimer timer(getMetrics().seek);
     if (frame->pkt_pos < 0 && !tryGetNext(result)) {
         throw std::runtime_error("Cannot seek to first frame");
     }
@@ -130,21 +304,22 @@ bool FrameService::trySeek(int64_t pts, AVFrame **result) {
         return true;
     }
 
-    const auto delta = pts - frame->pts;
-    if (delta > 1000) {
-        std::cout << "Seeking forward by " << delta << " frames, this might take a while" << std::endl;
-        if (av_seek_frame(fmt_ctx, video_stream_idx, pts * 0.95, 0) < 0) {
-            throw std::runtime_error("Seek failed");
-        }
+    // Only jump when the keyframe is ahead of us, otherwise decoding on from here is cheaper.
+    auto keyframe = keyframesOnly ? index->findFollowing(pts) : index->findPreceding(pts);
+    if (keyframe && keyframe->pts > frame->pts) {
+        std::cout << "Seeking forward by " << av_q2d(timeBase) * (keyframe->pts - frame->pts)
+                  << "s to keyframe @" << keyframe->pts << std::endl;
+        seekToKeyframe(*keyframe);
     }
 
-    while (frame->pts < pts) {
-        if (!tryGetNext(result)) {
-            return false;
-        }
-    }
+    discardBefore = pts;
+    auto found = true;
+    do {
+        found = tryGetNext(result);
+    } while (found && frame->pts < pts);
+    discardBefore = AV_NOPTS_VALUE;
 
-    return true;
+    return found;
 }
 
 
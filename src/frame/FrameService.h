@@ -1,7 +1,11 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include "VideoFormat.h"
+#include "KeyframeIndex.h"
+#include "../config/Config.h"
+#include "../library/Library.h"
 
 extern "C" {
     #include <libavformat/avformat.h>
@@ -13,20 +17,72 @@ class FrameService {
     AVPacket *pkt;
     AVFrame *frame;
     int video_stream_idx;
+    AVRational timeBase;
+    int64_t firstPts;
+    int64_t startPts;
+    int64_t frameDuration;
+    double durationSeconds;
+    std::unique_ptr<KeyframeIndex> index;
+    bool keyframesOnly;
+    int64_t discardBefore;
 
     bool tryGetNextPacket();
     bool tryGetNextFrame();
+    void loadIndex(const std::string& path, const std::string& indexPath);
+    void seekToKeyframe(const Keyframe& keyframe);
+    void configureDecoder(const AVCodec *codec, const Options& options);
+    bool tryUseProbedStream(const MovieInfo& movie, AVCodec **codec);
 public:
-    explicit FrameService(std::string path);
+    /**
+     * Sources much bigger than the visible area in options are decoded at reduced resolution where the codec can,
+     * and decoder threads are sized to the decoded frame.
+     * @param path Movie file to decode
+     * @param indexPath Where the keyframe index of the movie is persisted, it is built on first use
+     * @param movie What the library found out when it probed the movie, so that its stream information is not read
+     * ahead for again. nullptr to find it out from the file.
+     */
+    FrameService(const std::string& path, const std::string& indexPath, const MovieInfo *movie, Options *options);
     ~FrameService();
     bool tryGetNext(AVFrame **result);
 
     /**
-     * Seeks to the specified timestamp.
-     * @param pts Presentation timestamp to seek to
+     * Seeks to the specified timestamp, jumping to the preceding keyframe first when that is ahead of the current frame.
+     * Frames before pts that no later frame references are discarded by the decoder without being decoded.
+     * In keyframe only mode this lands on the first keyframe at or after pts and only keyframes are ever decoded.
+     * @param pts Presentation timestamp to seek to, in the video stream time base
      * @return true if successful, false otherwise
      */
     bool trySeek(int64_t pts, AVFrame **result);
 
     VideoFormat getFormat();
+
+    /**
+     * @return the time base of the video stream, which all pts are in.
+     */
+    AVRational getTimeBase() const;
+
+    /**
+     * @return the pts of the first frame of the stream, AV_NOPTS_VALUE if the container does not say.
+     */
+    int64_t getFirstPts() const;
+
+    /**
+     * @return the timestamp frames after pts, at the stream's average frame rate.
+     */
+    int64_t getPtsAfter(int64_t pts, int frames) const;
+
+    /**
+     * @return the timestamp position microseconds after the start of the stream.
+     */
+    int64_t getPtsAt(int64_t position) const;
+
+    /**
+     * @return how many microseconds after the start of the stream pts is.
+     */
+    int64_t getPosition(int64_t pts) const;
+
+    /**
+     * @return the length of the movie, 0 if the container does not say.
+     */
+    double getDurationSeconds() const;
 };
\ No newline at end of file
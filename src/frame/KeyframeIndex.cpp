@@ -0,0 +1,106 @@
+#include "KeyframeIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+#include <sys/stat.h>
+
+using json = nlohmann::json;
+
+const int INDEX_VERSION = 1;
+
+KeyframeIndex::KeyframeIndex(const std::string& moviePath, int streamIndex, AVRational timeBase)
+    : streamIndex(streamIndex), timeBase(timeBase) {
+    struct stat info {};
+    if (stat(moviePath.c_str(), &info) < 0) {
+        std::stringstream ss;
+        ss << "Cannot stat " << moviePath;
+        throw std::runtime_error(ss.str());
+    }
+    fileSize = info.st_size;
+    modified = info.st_mtime;
+}
+
+bool KeyframeIndex::tryLoad(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    json j;
+    try {
+        file >> j;
+    } catch (const json::exception&) {
+        return false;
+    }
+    file.close();
+
+    if (j.value("version", 0) != INDEX_VERSION
+        || j.value("size", (int64_t) -1) != fileSize
+        || j.value("modified", (int64_t) -1) != modified
+        || j.value("stream", -1) != streamIndex
+        || j.value("timeBase", std::vector<int>()) != std::vector<int> { timeBase.num, timeBase.den }) {
+        return false;
+    }
+
+    // Stored as flat [pts, seekTimestamp, pos] triples to keep the file small.
+    std::vector<int64_t> values = j.at("keyframes");
+    keyframes.clear();
+    for (size_t i = 0; i + 2 < values.size(); i += 3) {
+        keyframes.push_back({ .pts = values[i], .seekTimestamp = values[i + 1], .pos = values[i + 2] });
+    }
+    return true;
+}
+
+void KeyframeIndex::save(const std::string& path) const {
+    std::vector<int64_t> values;
+    values.reserve(keyframes.size() * 3);
+    for (const auto& keyframe : keyframes) {
+        values.push_back(keyframe.pts);
+        values.push_back(keyframe.seekTimestamp);
+        values.push_back(keyframe.pos);
+    }
+
+    json j = {
+        { "version", INDEX_VERSION },
+        { "size", fileSize },
+        { "modified", modified },
+        { "stream", streamIndex },
+        { "timeBase", { timeBase.num, timeBase.den } },
+        { "keyframes", values },
+    };
+
+    // Written beside the index and renamed over it, so a power cut never leaves a truncated index to load.
+    auto tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios_base::trunc);
+    file << j << std::endl;
+    file.close();
+    if (file.fail() || rename(tempPath.c_str(), path.c_str()) < 0) {
+        std::cerr << "Cannot write keyframe index to " << path << std::endl;
+    }
+}
+
+void KeyframeIndex::add(const Keyframe& keyframe) {
+    keyframes.push_back(keyframe);
+}
+
+const Keyframe* KeyframeIndex::findPreceding(int64_t pts) const {
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), pts,
+                                 [](int64_t value, const Keyframe& keyframe) { return value < keyframe.pts; });
+    return next == keyframes.begin() ? nullptr : &*(next - 1);
+}
+
+const Keyframe* KeyframeIndex::findFollowing(int64_t pts) const {
+    auto next = std::lower_bound(keyframes.begin(), keyframes.end(), pts,
+                                 [](const Keyframe& keyframe, int64_t value) { return keyframe.pts < value; });
+    return next == keyframes.end() ? nullptr : &*next;
+}
+
+size_t KeyframeIndex::size() const {
+    return keyframes.size();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include <libavutil/rational.h>
+}
+
+struct Keyframe {
+    /**
+     * Presentation timestamp of the keyframe, in the stream time base.
+     */
+    int64_t pts;
+
+    /**
+     * Timestamp to give av_seek_frame, the dts where known as some demuxers index by dts.
+     */
+    int64_t seekTimestamp;
+
+    /**
+     * Byte position of the keyframe packet.
+     */
+    int64_t pos;
+};
+
+/**
+ * Keyframes of the video stream of one movie file, persisted so that resume can jump straight to the keyframe
+ * preceding the saved position instead of decoding from the start.
+ */
+class KeyframeIndex {
+    int64_t fileSize;
+    int64_t modified;
+    int streamIndex;
+    AVRational timeBase;
+    std::vector<Keyframe> keyframes;
+
+public:
+    KeyframeIndex(const std::string& moviePath, int streamIndex, AVRational timeBase);
+
+    /**
+     * Loads a persisted index, which is only accepted if it was built for the same file, stream and time base.
+     * @return true if loaded, false if it is missing or stale.
+     */
+    bool tryLoad(const std::string& path);
+    void save(const std::string& path) const;
+
+    /**
+     * Keyframes must be added in pts order.
+     */
+    void add(const Keyframe& keyframe);
+
+    /**
+     * @return the last keyframe at or before pts, nullptr if there is none.
+     */
+    const Keyframe* findPreceding(int64_t pts) const;
+
+    /**
+     * @return the first keyframe at or after pts, nullptr if there is none.
+     */
+    const Keyframe* findFollowing(int64_t pts) const;
+
+    size_t size() const;
+};
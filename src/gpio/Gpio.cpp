@@ -1,59 +1,31 @@
-#include <sstream>
-#include <unistd.h>
 #include "Gpio.h"
 
-using namespace std;
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include "GpioChipLine.h"
+#include "SysfsGpio.h"
 
-template <class T>
-void safeWrite(const string& path, T value) {
-    ofstream file (path, ios::out | ios::binary);
-    if (!file.is_open()) {
-        stringstream ss;
-        ss << "Cannot write to " << path;
-        throw runtime_error(ss.str());
-    }
-    file << value;
-    file.close();
-}
-
-string getGpioPath(int pin, const string& value) {
-    stringstream ss;
-    ss << "/sys/class/gpio/gpio" << pin << "/" << value;
-    return ss.str();
-}
-
-Gpio::Gpio(int pin, PinDirection direction) :pin(pin), direction(direction) {
-    safeWrite("/sys/class/gpio/export", pin);
-
-    // We need to allow time for the udev rules to fire.
-    sleep(1);
-
-    auto directionPath = getGpioPath(pin, "direction");
-    safeWrite(directionPath, direction == in ? "in" : "out");
+const char *GPIO_CHIP = "/dev/gpiochip0";
 
-    path = getGpioPath(pin, "value");
-}
-
-Gpio::~Gpio() {
-    safeWrite("/sys/class/gpio/unexport", pin);
-}
-
-bool Gpio::readValue() const {
-    ifstream file;
-    file.open(path, ios::in | ios::binary);
-    if (!file.is_open()) {
-        stringstream ss;
-        ss << "Cannot read from " << path;
-        throw runtime_error(ss.str());
+std::unique_ptr<Gpio> openGpio(int pin, PinDirection direction) {
+    try {
+        return std::unique_ptr<Gpio>(new GpioChipLine(GPIO_CHIP, pin, direction));
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << ", falling back to sysfs for pin " << pin << std::endl;
+        return std::unique_ptr<Gpio>(new SysfsGpio(pin, direction));
     }
-
-    uint8_t i;
-    file >> i;
-    file.close();
-
-    return (i & 0x01u) == 0x01u;
 }
 
-void Gpio::writeValue(bool value) const {
-    safeWrite(path, value ? '1' : '0');
+bool Gpio::waitForValue(bool value, int timeoutMs) const {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (readValue() != value) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            return false;
+        }
+        waitForEdge((int) remaining);
+    }
+    return true;
 }
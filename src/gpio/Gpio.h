@@ -1,18 +1,35 @@
 #pragma once
 
-#include <fstream>
+#include <memory>
+#include <string>
 
 enum PinDirection { in, out };
 
+/**
+ * A GPIO pin held open for its lifetime, reading or writing it is at most one syscall.
+ */
 class Gpio {
-    int pin;
-    PinDirection direction;
-    std::string path;
+protected:
+    /**
+     * Blocks until an edge on an input pin or timeoutMs passes, whichever is first. May return early.
+     */
+    virtual void waitForEdge(int timeoutMs) const = 0;
 
 public:
-    Gpio(int pin, PinDirection direction);
-    ~Gpio();
+    virtual ~Gpio() = default;
 
-    bool readValue() const;
-    void writeValue(bool value) const;
-};
\ No newline at end of file
+    virtual bool readValue() const = 0;
+    virtual void writeValue(bool value) const = 0;
+
+    /**
+     * Sleeps on edge events of an input pin until it reads value.
+     * @return false if it did not within timeoutMs.
+     */
+    bool waitForValue(bool value, int timeoutMs) const;
+};
+
+/**
+ * Requests the pin as a line of the GPIO character device, falling back to sysfs on kernels without it.
+ * @param pin BCM pin number, which is the line offset on the first gpiochip of a Raspberry Pi.
+ */
+std::unique_ptr<Gpio> openGpio(int pin, PinDirection direction);
@@ -0,0 +1,84 @@
+#include "GpioChipLine.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+const char *CONSUMER = "vsmp";
+
+GpioChipLine::GpioChipLine(const std::string& chip, int line, PinDirection direction) : lastValue(-1) {
+    auto chipFd = open(chip.c_str(), O_RDONLY);
+    if (chipFd < 0) {
+        std::stringstream ss;
+        ss << "Cannot open gpio chip " << chip;
+        throw std::runtime_error(ss.str());
+    }
+
+    // An event line also answers GPIOHANDLE_GET_LINE_VALUES_IOCTL, so it serves for reading too.
+    int result;
+    if (direction == in) {
+        gpioevent_request request {};
+        request.lineoffset = line;
+        request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+        request.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+        strncpy(request.consumer_label, CONSUMER, sizeof(request.consumer_label) - 1);
+        result = ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &request);
+        fd = request.fd;
+    } else {
+        gpiohandle_request request {};
+        request.lineoffsets[0] = line;
+        request.lines = 1;
+        request.flags = GPIOHANDLE_REQUEST_OUTPUT;
+        strncpy(request.consumer_label, CONSUMER, sizeof(request.consumer_label) - 1);
+        result = ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &request);
+        fd = request.fd;
+    }
+
+    close(chipFd);
+    if (result < 0) {
+        std::stringstream ss;
+        ss << "Cannot request line " << line << " of " << chip;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+GpioChipLine::~GpioChipLine() {
+    close(fd);
+}
+
+bool GpioChipLine::readValue() const {
+    gpiohandle_data data {};
+    if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
+        throw std::runtime_error("Cannot read gpio line");
+    }
+    return data.values[0] != 0;
+}
+
+void GpioChipLine::writeValue(bool value) const {
+    // Commands and data toggle DC constantly, mostly to the value it already has.
+    if (lastValue == value) {
+        return;
+    }
+
+    gpiohandle_data data {};
+    data.values[0] = value ? 1 : 0;
+    if (ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0) {
+        throw std::runtime_error("Cannot write gpio line");
+    }
+    lastValue = value;
+}
+
+void GpioChipLine::waitForEdge(int timeoutMs) const {
+    pollfd events { .fd = fd, .events = POLLIN, .revents = 0 };
+    if (poll(&events, 1, timeoutMs) > 0) {
+        gpioevent_data event {};
+        if (read(fd, &event, sizeof(event)) < 0) {
+            throw std::runtime_error("Cannot read gpio line event");
+        }
+    }
+}
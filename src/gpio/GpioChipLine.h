@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Gpio.h"
+
+/**
+ * A line requested from a /dev/gpiochipN character device. Values are read and written with one ioctl on the line
+ * handle and the line is released when the handle is closed. Inputs are requested as event lines so that edges can be
+ * waited on.
+ */
+class GpioChipLine : public Gpio {
+    int fd;
+    mutable int lastValue;
+
+protected:
+    void waitForEdge(int timeoutMs) const override;
+
+public:
+    GpioChipLine(const std::string& chip, int line, PinDirection direction);
+    ~GpioChipLine() override;
+
+    bool readValue() const override;
+    void writeValue(bool value) const override;
+};
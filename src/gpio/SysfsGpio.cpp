@@ -0,0 +1,96 @@
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "SysfsGpio.h"
+
+using namespace std;
+
+// udev usually fixes up a newly exported pin within tens of milliseconds.
+const int EXPORT_POLL_MS = 10;
+const int EXPORT_TIMEOUT_MS = 5000;
+
+template <class T>
+void safeWrite(const string& path, T value) {
+    ofstream file (path, ios::out | ios::binary);
+    if (!file.is_open()) {
+        stringstream ss;
+        ss << "Cannot write to " << path;
+        throw runtime_error(ss.str());
+    }
+    file << value;
+    file.close();
+}
+
+string getGpioPath(int pin, const string& value) {
+    stringstream ss;
+    ss << "/sys/class/gpio/gpio" << pin << "/" << value;
+    return ss.str();
+}
+
+SysfsGpio::SysfsGpio(int pin, PinDirection direction) :pin(pin), lastValue(-1) {
+    safeWrite("/sys/class/gpio/export", pin);
+
+    // The pin's files can only be written once the udev rules have fired, so wait for that rather than a fixed time.
+    auto directionPath = getGpioPath(pin, "direction");
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(EXPORT_TIMEOUT_MS);
+    while (access(directionPath.c_str(), W_OK) < 0) {
+        if (chrono::steady_clock::now() >= deadline) {
+            stringstream ss;
+            ss << "Gpio " << pin << " was not ready " << EXPORT_TIMEOUT_MS << "ms after export";
+            throw runtime_error(ss.str());
+        }
+        usleep(EXPORT_POLL_MS * 1000);
+    }
+
+    safeWrite(directionPath, direction == in ? "in" : "out");
+    if (direction == in) {
+        safeWrite(getGpioPath(pin, "edge"), "both");
+    }
+
+    auto path = getGpioPath(pin, "value");
+    if ((fd = open(path.c_str(), direction == in ? O_RDONLY : O_RDWR)) < 0) {
+        stringstream ss;
+        ss << "Cannot open " << path;
+        throw runtime_error(ss.str());
+    }
+}
+
+SysfsGpio::~SysfsGpio() {
+    close(fd);
+    safeWrite("/sys/class/gpio/unexport", pin);
+}
+
+bool SysfsGpio::readValue() const {
+    // sysfs attributes are re-read from the start on every read, so pread needs no seek.
+    char value;
+    if (pread(fd, &value, 1, 0) != 1) {
+        stringstream ss;
+        ss << "Cannot read gpio " << pin;
+        throw runtime_error(ss.str());
+    }
+    return value == '1';
+}
+
+void SysfsGpio::writeValue(bool value) const {
+    if (lastValue == value) {
+        return;
+    }
+
+    auto c = value ? '1' : '0';
+    if (pwrite(fd, &c, 1, 0) != 1) {
+        stringstream ss;
+        ss << "Cannot write gpio " << pin;
+        throw runtime_error(ss.str());
+    }
+    lastValue = value;
+}
+
+void SysfsGpio::waitForEdge(int timeoutMs) const {
+    // sysfs flags edges as POLLPRI on the value file, cleared by the next read.
+    pollfd events { .fd = fd, .events = POLLPRI | POLLERR, .revents = 0 };
+    poll(&events, 1, timeoutMs);
+}
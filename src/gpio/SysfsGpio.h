@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Gpio.h"
+
+/**
+ * A pin exported through /sys/class/gpio, with its value file kept open.
+ */
+class SysfsGpio : public Gpio {
+    int pin;
+    int fd;
+    mutable int lastValue;
+
+protected:
+    void waitForEdge(int timeoutMs) const override;
+
+public:
+    SysfsGpio(int pin, PinDirection direction);
+    ~SysfsGpio() override;
+
+    bool readValue() const override;
+    void writeValue(bool value) const override;
+};
@@ -0,0 +1,417 @@
+#include "Library.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "../dither/LumaScaler.h"
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+using json = nlohmann::json;
+
+// 2 added what reading ahead found out about the video stream.
+const int LIBRARY_VERSION = 2;
+
+const std::vector<std::string> MOVIE_EXTENSIONS = { "mp4", "m4v", "mkv", "avi", "mov", "webm", "mpg", "mpeg", "ts" };
+
+// Frames sampled for the black frame ratio, and packets read after each seek to decode one.
+const int BLACK_SAMPLES = 10;
+const int MAX_SAMPLE_PACKETS = 64;
+
+// Luma at or below this is black in either limited or full range.
+const int BLACK_LEVEL = 24;
+
+bool isMovieFile(const std::string& name) {
+    // Hidden files include partial copies, e.g. from rsync.
+    auto dot = name.find_last_of('.');
+    if (name.empty() || name[0] == '.' || dot == std::string::npos) {
+        return false;
+    }
+    auto extension = name.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return std::find(MOVIE_EXTENSIONS.begin(), MOVIE_EXTENSIONS.end(), extension) != MOVIE_EXTENSIONS.end();
+}
+
+bool isBlack(const AVFrame *frame) {
+    for (auto y = 0; y < frame->height; y++) {
+        auto row = frame->data[0] + y * frame->linesize[0];
+        if (*std::max_element(row, row + frame->width) > BLACK_LEVEL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double sampleBlackFrames(AVFormatContext *fmt_ctx, int streamIndex, AVCodecContext *dec_ctx) {
+    auto stream = fmt_ctx->streams[streamIndex];
+    auto start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    auto duration = stream->duration != AV_NOPTS_VALUE
+            ? stream->duration
+            : av_rescale_q(fmt_ctx->duration, AVRational { 1, AV_TIME_BASE }, stream->time_base);
+    if (duration <= 0) {
+        return -1;
+    }
+
+    auto pkt = av_packet_alloc();
+    auto frame = av_frame_alloc();
+    auto sampled = 0;
+    auto black = 0;
+    auto supported = true;
+    for (auto i = 0; i < BLACK_SAMPLES && supported; i++) {
+        // The middle of each of BLACK_SAMPLES equal spans.
+        auto target = start + duration * (2 * i + 1) / (2 * BLACK_SAMPLES);
+        if (av_seek_frame(fmt_ctx, streamIndex, target, AVSEEK_FLAG_BACKWARD) < 0) {
+            break;
+        }
+        avcodec_flush_buffers(dec_ctx);
+
+        auto decoded = false;
+        for (auto packets = 0; packets < MAX_SAMPLE_PACKETS && !decoded && av_read_frame(fmt_ctx, pkt) >= 0; packets++) {
+            if (pkt->stream_index == streamIndex && avcodec_send_packet(dec_ctx, pkt) >= 0) {
+                decoded = avcodec_receive_frame(dec_ctx, frame) >= 0;
+            }
+            av_packet_unref(pkt);
+        }
+        if (!decoded) {
+            continue;
+        }
+
+        VideoFormat format = { .width = frame->width, .height = frame->height, .pixelFormat = (AVPixelFormat) frame->format };
+        supported = LumaScaler::supports(format, 1, 1);
+        if (supported) {
+            sampled++;
+            black += isBlack(frame) ? 1 : 0;
+        }
+        av_frame_unref(frame);
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    return supported && sampled > 0 ? (double) black / sampled : -1;
+}
+
+double getBlackFrameRatio(AVFormatContext *fmt_ctx, int streamIndex, const AVCodec *codec) {
+    auto dec_ctx = avcodec_alloc_context3(codec);
+    if (!dec_ctx) {
+        return -1;
+    }
+
+    // Only the luma level matters, so decode as small as the codec allows.
+    auto ratio = -1.0;
+    if (avcodec_parameters_to_context(dec_ctx, fmt_ctx->streams[streamIndex]->codecpar) >= 0) {
+        dec_ctx->lowres = std::min((int) codec->max_lowres, 3);
+        if (avcodec_open2(dec_ctx, codec, nullptr) >= 0) {
+            ratio = sampleBlackFrames(fmt_ctx, streamIndex, dec_ctx);
+        }
+    }
+    avcodec_free_context(&dec_ctx);
+    return ratio;
+}
+
+MovieInfo probe(const std::string& path, const std::string& name, const struct stat& info) {
+    MovieInfo movie = {
+        .name = name,
+        .size = info.st_size,
+        .modified = info.st_mtime,
+        .playable = false,
+        .durationSeconds = 0,
+        .frameCount = 0,
+        .width = 0,
+        .height = 0,
+        .codec = "",
+        .blackFrameRatio = -1,
+        .streamIndex = -1,
+        .pixelFormat = AV_PIX_FMT_NONE,
+        .firstPts = AV_NOPTS_VALUE,
+        .frameRateNum = 0,
+        .frameRateDen = 0,
+    };
+
+    AVFormatContext *fmt_ctx = nullptr;
+    if (avformat_open_input(&fmt_ctx, path.c_str(), nullptr, nullptr) < 0) {
+        return movie;
+    }
+
+    AVCodec *codec = nullptr;
+    auto streamIndex = avformat_find_stream_info(fmt_ctx, nullptr) >= 0
+            ? av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)
+            : -1;
+    if (streamIndex >= 0 && codec) {
+        auto stream = fmt_ctx->streams[streamIndex];
+        auto frameRate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+        movie.playable = true;
+        movie.durationSeconds = stream->duration != AV_NOPTS_VALUE
+                ? stream->duration * av_q2d(stream->time_base)
+                : fmt_ctx->duration != AV_NOPTS_VALUE ? (double) fmt_ctx->duration / AV_TIME_BASE : 0;
+        movie.frameCount = stream->nb_frames > 0
+                ? stream->nb_frames
+                : (int64_t) (movie.durationSeconds * (frameRate.den ? av_q2d(frameRate) : 0));
+        movie.width = stream->codecpar->width;
+        movie.height = stream->codecpar->height;
+        movie.codec = avcodec_get_name(stream->codecpar->codec_id);
+        movie.streamIndex = streamIndex;
+        movie.pixelFormat = stream->codecpar->format;
+        movie.firstPts = stream->start_time;
+        movie.frameRateNum = frameRate.num;
+        movie.frameRateDen = frameRate.den;
+        movie.blackFrameRatio = getBlackFrameRatio(fmt_ctx, streamIndex, codec);
+    }
+
+    avformat_close_input(&fmt_ctx);
+    return movie;
+}
+
+bool byName(const MovieInfo& movie, const std::string& name) {
+    return movie.name < name;
+}
+
+Library::Library(const std::string& moviesPath, const std::string& cachePath)
+    : moviesPath(moviesPath), cachePath(cachePath), inotifyFd(-1), dirty(false) {
+    load();
+
+    // Watch before listing so that nothing changed in between is missed.
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, moviesPath.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    if (inotifyFd < 0) {
+        std::cerr << "Cannot watch " << moviesPath << ", it will be listed on every update" << std::endl;
+    }
+
+    // The directory may have changed while we were not running.
+    scan();
+    if (dirty) {
+        save();
+    }
+}
+
+Library::~Library() {
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+}
+
+void Library::load() {
+    std::ifstream file(cachePath);
+    if (!file.is_open()) {
+        return;
+    }
+
+    json j;
+    try {
+        file >> j;
+        if (j.value("version", 0) != LIBRARY_VERSION || j.value("path", "") != moviesPath) {
+            return;
+        }
+
+        for (const auto& movie : j.at("movies")) {
+            movies.push_back({
+                .name = movie.at("name"),
+                .size = movie.at("size"),
+                .modified = movie.at("modified"),
+                .playable = movie.at("playable"),
+                .durationSeconds = movie.at("duration"),
+                .frameCount = movie.at("frames"),
+                .width = movie.at("width"),
+                .height = movie.at("height"),
+                .codec = movie.at("codec"),
+                .blackFrameRatio = movie.at("blackFrameRatio"),
+                .streamIndex = movie.at("stream"),
+                .pixelFormat = movie.at("pixelFormat"),
+                .firstPts = movie.at("firstPts"),
+                .frameRateNum = movie.at("frameRate").at(0),
+                .frameRateDen = movie.at("frameRate").at(1),
+            });
+        }
+    } catch (const json::exception&) {
+        movies.clear();
+        return;
+    }
+    std::sort(movies.begin(), movies.end(), [](const MovieInfo& a, const MovieInfo& b) { return a.name < b.name; });
+}
+
+void Library::save() {
+    auto values = json::array();
+    for (const auto& movie : movies) {
+        values.push_back({
+            { "name", movie.name },
+            { "size", movie.size },
+            { "modified", movie.modified },
+            { "playable", movie.playable },
+            { "duration", movie.durationSeconds },
+            { "frames", movie.frameCount },
+            { "width", movie.width },
+            { "height", movie.height },
+            { "codec", movie.codec },
+            { "blackFrameRatio", movie.blackFrameRatio },
+            { "stream", movie.streamIndex },
+            { "pixelFormat", movie.pixelFormat },
+            { "firstPts", movie.firstPts },
+            { "frameRate", { movie.frameRateNum, movie.frameRateDen } },
+        });
+    }
+
+    json j = {
+        { "version", LIBRARY_VERSION },
+        { "path", moviesPath },
+        { "movies", values },
+    };
+
+    // The cache is only an optimisation, it is rebuilt if this fails.
+    auto tempPath = cachePath + ".tmp";
+    std::ofstream file(tempPath, std::ios_base::trunc);
+    file << j << std::endl;
+    file.close();
+    if (file.fail() || rename(tempPath.c_str(), cachePath.c_str()) < 0) {
+        std::cerr << "Cannot write library to " << cachePath << std::endl;
+    }
+    dirty = false;
+}
+
+void Library::scan() {
+    auto dir = opendir(moviesPath.c_str());
+    if (!dir) {
+        std::stringstream ss;
+        ss << "Cannot open movie path " << moviesPath;
+        throw std::runtime_error(ss.str());
+    }
+
+    std::vector<std::string> names;
+    for (auto ent = readdir(dir); ent; ent = readdir(dir)) {
+        std::string name(ent->d_name);
+        if (isMovieFile(name)) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    for (auto movie = movies.begin(); movie != movies.end();) {
+        if (std::binary_search(names.begin(), names.end(), movie->name)) {
+            movie++;
+        } else {
+            movie = movies.erase(movie);
+            dirty = true;
+        }
+    }
+    for (const auto& name : names) {
+        updateFile(name);
+    }
+}
+
+void Library::updateFile(const std::string& name) {
+    if (!isMovieFile(name)) {
+        return;
+    }
+
+    auto path = moviesPath + "/" + name;
+    struct stat info {};
+    if (stat(path.c_str(), &info) < 0 || !S_ISREG(info.st_mode)) {
+        removeFile(name);
+        return;
+    }
+
+    auto movie = std::lower_bound(movies.begin(), movies.end(), name, byName);
+    auto cached = movie != movies.end() && movie->name == name;
+    if (cached && movie->size == info.st_size && movie->modified == info.st_mtime) {
+        return;
+    }
+
+    std::cout << "Probing " << path << std::endl;
+    auto probed = probe(path, name, info);
+    if (cached) {
+        *movie = probed;
+    } else {
+        movies.insert(movie, probed);
+    }
+    dirty = true;
+}
+
+void Library::removeFile(const std::string& name) {
+    auto movie = std::lower_bound(movies.begin(), movies.end(), name, byName);
+    if (movie != movies.end() && movie->name == name) {
+        movies.erase(movie);
+        dirty = true;
+    }
+}
+
+void Library::update() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto rescan = inotifyFd < 0;
+    if (inotifyFd >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (auto next = buffer; next < buffer + length;) {
+                auto event = (const inotify_event *) next;
+                next += sizeof(inotify_event) + event->len;
+
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    // The watch is gone with the directory, fall back to listing it.
+                    close(inotifyFd);
+                    inotifyFd = -1;
+                    rescan = true;
+                    break;
+                }
+                if (event->mask & IN_Q_OVERFLOW) {
+                    rescan = true;
+                } else if (event->len > 0 && (event->mask & (IN_DELETE | IN_MOVED_FROM))) {
+                    removeFile(event->name);
+                } else if (event->len > 0) {
+                    updateFile(event->name);
+                }
+            }
+            if (inotifyFd < 0) {
+                break;
+            }
+        }
+    }
+
+    if (rescan) {
+        scan();
+    }
+    if (dirty) {
+        save();
+    }
+}
+
+std::vector<std::string> Library::getPlayable(double maxBlackFrameRatio) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> result;
+    for (const auto& movie : movies) {
+        if (movie.playable && movie.blackFrameRatio <= maxBlackFrameRatio) {
+            result.push_back(movie.name);
+        }
+    }
+    return result;
+}
+
+std::unique_ptr<MovieInfo> Library::find(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto movie = std::lower_bound(movies.begin(), movies.end(), name, byName);
+    if (movie == movies.end() || movie->name != name) {
+        return nullptr;
+    }
+
+    // Nothing may have told us of a change yet, e.g. on a cold start resuming the movie without an update.
+    struct stat info {};
+    auto path = moviesPath + "/" + name;
+    if (stat(path.c_str(), &info) < 0 || movie->size != info.st_size || movie->modified != info.st_mtime) {
+        return nullptr;
+    }
+    return std::unique_ptr<MovieInfo>(new MovieInfo(*movie));
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct MovieInfo {
+    /**
+     * File name within the movies directory.
+     */
+    std::string name;
+    int64_t size;
+    int64_t modified;
+
+    /**
+     * false if the file could not be opened or has no video, it is kept so it is not probed again until it changes.
+     */
+    bool playable;
+    double durationSeconds;
+    int64_t frameCount;
+    int width;
+    int height;
+    std::string codec;
+
+    /**
+     * Fraction of frames sampled across the movie that were black, -1 if the pixel format could not be checked.
+     */
+    double blackFrameRatio;
+
+    /**
+     * What reading ahead in the movie found out about its video stream beyond the header, so that FrameService need
+     * not read ahead again: the stream's index, its AVPixelFormat, the pts of its first frame (AV_NOPTS_VALUE if
+     * unknown) and its average frame rate (0/0 if unknown). streamIndex is -1 if the movie is not playable.
+     */
+    int streamIndex;
+    int pixelFormat;
+    int64_t firstPts;
+    int frameRateNum;
+    int frameRateDen;
+};
+
+/**
+ * The movie files in the movies directory with their metadata, cached on disk so that only new or changed files are
+ * ever probed. Movies are ordered by file name. Once loaded, changes to the directory are picked up from inotify
+ * rather than by listing it again. Safe to share between the panels playing from one directory.
+ */
+class Library {
+    std::string moviesPath;
+    std::string cachePath;
+    std::vector<MovieInfo> movies;
+    int inotifyFd;
+    bool dirty;
+    mutable std::mutex mutex;
+
+    void load();
+    void save();
+    void scan();
+    void updateFile(const std::string& name);
+    void removeFile(const std::string& name);
+
+public:
+    Library(const std::string& moviesPath, const std::string& cachePath);
+    ~Library();
+
+    /**
+     * Applies any changes to the directory since the last update.
+     */
+    void update();
+
+    /**
+     * @return the names of every playable movie, in order, bar those with more than maxBlackFrameRatio of their sampled
+     * frames black.
+     */
+    std::vector<std::string> getPlayable(double maxBlackFrameRatio) const;
+
+    /**
+     * @return the movie called name as it was probed, nullptr if there is none or the file has changed since.
+     */
+    std::unique_ptr<MovieInfo> find(const std::string& name) const;
+};
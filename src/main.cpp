@@ -1,86 +1,109 @@
 #include <iostream>
 #include <memory>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
 
-#define E_PAPER 1
-
-#include "dither/DitherService.h"
-#include "frame/FrameService.h"
 #include "config/Config.h"
-#include "sleep/SleepService.h"
+#include "prefetch/PrefetchService.h"
+#include "bake/BakedMovie.h"
+#include "display/Display.h"
+#include "metrics/StatsWriter.h"
+#include "player/Player.h"
+
+/**
+ * Decodes and dithers every displayable frame of a movie ahead of time into a file that playback memory maps.
+ * @param options Those of the panel that will play the bake, whose display size and movie area it is made for.
+ */
+void bake(Config& config, Options& options, const std::string& movie) {
+    auto file = movie.find('/') == std::string::npos ? options.path + "/" + movie : movie;
+    auto path = config.getBakePath(file);
+    const auto width = options.display.width;
+    const auto height = options.display.height;
+    auto key = getBakeKey(file, options, width, height);
+
+    std::cout << "Baking " << file << " to " << path << std::endl;
+
+    std::unique_ptr<PrefetchService> prefetch(new PrefetchService(
+            file, config.getIndexPath(file), nullptr, &options, width, height, AV_NOPTS_VALUE, -1, nullptr));
+    BakeWriter writer(path, key, width, height, width * height / 8);
+    PreparedFrame frame;
+    uint64_t frames = 0;
+    while (prefetch->tryTakeNext(frame)) {
+        writer.append(frame);
+        frames++;
+    }
+    writer.finish();
 
-#if E_PAPER
-    #include "epaper/EPaperDisplay.h"
-#else
-    const int EPD_WIDTH = 800;
-    const int EPD_HEIGHT = 480;
-#endif
+    auto raw = frames * (width * height / 8);
+    std::cout << "Baked " << frames << " frames into " << writer.size() << " bytes, "
+              << (raw > 0 ? (double) raw / writer.size() : 0) << "x smaller than raw" << std::endl;
+}
 
 // TODO validate state & options
 int main(int argc, char *argv[]) {
+    auto started = std::chrono::steady_clock::now();
     std::unique_ptr<Config> config(new Config);
 
-    #if E_PAPER
-        std::unique_ptr<EPaperDisplay> display(new EPaperDisplay);
-        display->init();
-
-        std::vector<std::string> arguments(argv + 1, argv + argc);
-        if (std::find(arguments.begin(), arguments.end(), "--test") != arguments.end()) {
-            display->writeTestPattern(config->options);
-            return 0;
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    if (!arguments.empty() && arguments.front() == "bake") {
+        // Bakes follow the top level options unless they are for a panel of its own size or movie area.
+        auto options = &config->options;
+        auto movies = arguments.begin() + 1;
+        if (movies != arguments.end() && *movies == "--panel" && movies + 1 != arguments.end()) {
+            auto panel = std::find_if(config->panels.begin(), config->panels.end(),
+                                      [&](const PanelOptions& panel) { return panel.name == *(movies + 1); });
+            if (panel == config->panels.end()) {
+                std::cerr << "No panel called " << *(movies + 1) << " in options.json" << std::endl;
+                return 1;
+            }
+            options = &panel->options;
+            movies += 2;
         }
-    #endif
-
-    auto state = config->getState();
-    if (!state) {
-        state = config->setNextState();
+        if (movies == arguments.end() || *movies == "--panel") {
+            std::cerr << "Usage: vsmp bake [--panel name] <movie>..." << std::endl;
+            return 1;
+        }
+        for (; movies != arguments.end(); movies++) {
+            bake(*config, *options, *movies);
+        }
+        return 0;
     }
 
-    std::unique_ptr<SleepService> sleep(new SleepService(&config->options));
-
-    while (state) {
-        std::unique_ptr<FrameService> frameService(new FrameService(state->file));
-        std::unique_ptr<DitherService> ditherService(new DitherService(
-                frameService->getFormat(), &config->options, EPD_WIDTH, EPD_HEIGHT));
-        AVFrame *frame = nullptr;
-
-        std::cout << "Writing file " << state->file << " @" << state->pts + 1 << std::endl;
-
-        #if E_PAPER
-            auto firstFrame = true;
-        #endif
-        auto skippedFrames = 0;
-        while (frameService->trySeek(state->pts + 1, &frame)) {
-            // Skip all black frames.
-            if (ditherService->tryDitherNonEmpty(frame)
-                && ++skippedFrames == config->options.frameSkip) {
-
-                #if E_PAPER
-                    sleep->sleepUntilHoursOfOperation();
-                    if (firstFrame) {
-                        firstFrame = false;
-                        sleep->reset();
-                    } else {
-                        sleep->sleepAndReset();
-                    }
-                    std::cout << "Displaying frame " << frame->pts << std::endl;
-                    display->write(ditherService->result);
-                #else
-                    auto file = fopen("/home/alex/src/vsmp/raw", "wb");
-                    fwrite(ditherService->result.data(), 1, ditherService->result.size(), file);
-                    fclose(file);
-                #endif
+    if (std::find(arguments.begin(), arguments.end(), "--test") != arguments.end()) {
+        for (const auto& panel : config->panels) {
+            auto display = createDisplay(panel.options.display);
+            display->init();
+            display->writeTestPattern(panel.options);
+        }
+        return 0;
+    }
 
-                skippedFrames = 0;
-            }
+    std::unique_ptr<PrefetchWorkers> workers(new PrefetchWorkers(config->options));
+    std::unique_ptr<StatsWriter> stats;
+    if (config->options.statsSeconds > 0) {
+        stats.reset(new StatsWriter(config->getStatsPath(), config->options.statsSeconds));
+    }
 
-            config->setPts(*state, frame->pts);
-        }
+    std::vector<std::unique_ptr<Player>> players;
+    for (auto& panel : config->panels) {
+        players.emplace_back(new Player(config.get(), &panel, workers.get(), started));
+    }
 
-        state = config->setNextState();
+    if (players.size() == 1) {
+        players.front()->run();
+        return 0;
     }
 
-    std::cerr << "No movie files found in " << config->options.path << std::endl;
+    // Panels share the decoding and dithering through workers, but each waits for its own display.
+    std::vector<std::thread> threads;
+    for (auto& player : players) {
+        threads.emplace_back(&Player::run, player.get());
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
 
     return 0;
-}
\ No newline at end of file
+}
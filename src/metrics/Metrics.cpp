@@ -0,0 +1,116 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <sys/resource.h>
+
+using json = nlohmann::json;
+
+// Bucket i holds samples up to 1024 << i ns, about 1us << i.
+const int BUCKET_SHIFT = 10;
+
+double getBucketBoundUs(int bucket) {
+    return (double) ((uint64_t) 1 << (bucket + BUCKET_SHIFT)) / 1000;
+}
+
+Histogram::Histogram() : count(0), totalNanoseconds(0), maxNanoseconds(0) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(int64_t nanoseconds) {
+    auto value = (uint64_t) std::max(nanoseconds, (int64_t) 0);
+    auto scaled = value >> BUCKET_SHIFT;
+    auto bucket = scaled == 0 ? 0 : std::min(HISTOGRAM_BUCKETS - 1, 64 - __builtin_clzll(scaled));
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    totalNanoseconds.fetch_add(value, std::memory_order_relaxed);
+
+    auto max = maxNanoseconds.load(std::memory_order_relaxed);
+    while (value > max && !maxNanoseconds.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+void Histogram::recordSince(std::chrono::steady_clock::time_point start) {
+    record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+json Histogram::toJson() const {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+    for (auto i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    // A bucket's bound can be well past anything recorded, the max is a tighter bound for the top bucket.
+    auto maxUs = maxNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+    auto percentile = [&counts, total, maxUs](double p) {
+        uint64_t seen = 0;
+        for (auto i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen > 0 && seen >= p * total) {
+                return std::min(getBucketBoundUs(i), maxUs);
+            }
+        }
+        return 0.0;
+    };
+
+    json nonEmpty = json::array();
+    for (auto i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (counts[i] > 0) {
+            nonEmpty.push_back({ getBucketBoundUs(i), counts[i] });
+        }
+    }
+
+    auto totalUs = totalNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+    return {
+        { "count", total },
+        { "totalUs", totalUs },
+        { "meanUs", total > 0 ? totalUs / total : 0 },
+        { "maxUs", maxUs },
+        { "p50Us", percentile(0.5) },
+        { "p90Us", percentile(0.9) },
+        { "p99Us", percentile(0.99) },
+        { "buckets", nonEmpty },
+    };
+}
+
+double toSeconds(const timeval& time) {
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+json Metrics::toJson() const {
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return {
+        { "cpu", {
+            { "userSeconds", toSeconds(usage.ru_utime) },
+            { "systemSeconds", toSeconds(usage.ru_stime) },
+            { "maxResidentKb", usage.ru_maxrss },
+        }},
+        { "stages", {
+            { "seek", seek.toJson() },
+            { "decode", decode.toJson() },
+            { "scale", scale.toJson() },
+            { "blackCheck", blackCheck.toJson() },
+            { "dither", dither.toJson() },
+            { "pack", pack.toJson() },
+            { "spiTransfer", spiTransfer.toJson() },
+            { "refresh", refresh.toJson() },
+            { "displayInit", displayInit.toJson() },
+            { "firstFrame", firstFrame.toJson() },
+        }},
+        { "counters", {
+            { "framesDisplayed", framesDisplayed.get() },
+            { "blackFramesSkipped", blackFramesSkipped.get() },
+            { "unchangedFramesSkipped", unchangedFramesSkipped.get() },
+            { "spiBytes", spiBytes.get() },
+        }},
+    };
+}
+
+Metrics& getMetrics() {
+    static Metrics metrics;
+    return metrics;
+}
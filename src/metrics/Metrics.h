@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+const int HISTOGRAM_BUCKETS = 40;
+
+/**
+ * Latency histogram with power of 2 buckets from 1us up, cheap enough to record into on every row of every frame and
+ * safe to record into from any thread.
+ */
+class Histogram {
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalNanoseconds;
+    std::atomic<uint64_t> maxNanoseconds;
+
+public:
+    Histogram();
+
+    void record(int64_t nanoseconds);
+    void recordSince(std::chrono::steady_clock::time_point start);
+
+    /**
+     * @return count, total, mean, max and p50/p90/p99 (upper bucket bounds) in microseconds, plus the non-empty buckets
+     * as [upper bound us, count] pairs.
+     */
+    nlohmann::json toJson() const;
+};
+
+class Counter {
+    std::atomic<uint64_t> value;
+
+public:
+    Counter() : value(0) {}
+
+    void add(uint64_t amount) {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const {
+        return value.load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Records the time from construction to destruction into a histogram.
+ */
+class ScopedTimer {
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Histogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.recordSince(start);
+    }
+};
+
+/**
+ * Every hot path stage of playback, from seeking in the movie to the panel refresh.
+ */
+struct Metrics {
+    Histogram seek;
+    Histogram decode;
+    Histogram scale;
+    Histogram blackCheck;
+    Histogram dither;
+
+    /**
+     * Per row, rows are packed as they are dithered.
+     */
+    Histogram pack;
+    Histogram spiTransfer;
+    Histogram refresh;
+
+    /**
+     * From start up to the display being ready, and to the first frame being shown.
+     */
+    Histogram displayInit;
+    Histogram firstFrame;
+
+    Counter framesDisplayed;
+    Counter blackFramesSkipped;
+    Counter unchangedFramesSkipped;
+    Counter spiBytes;
+
+    nlohmann::json toJson() const;
+};
+
+/**
+ * @return the metrics of this process.
+ */
+Metrics& getMetrics();
@@ -0,0 +1,49 @@
+#include "StatsWriter.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "Metrics.h"
+
+StatsWriter::StatsWriter(const std::string& path, int intervalSeconds)
+    : path(path), interval(intervalSeconds), started(std::chrono::steady_clock::now()), stopping(false) {
+    if (intervalSeconds <= 0) {
+        throw std::runtime_error("Stats interval must be at least a second");
+    }
+    worker = std::thread(&StatsWriter::work, this);
+}
+
+StatsWriter::~StatsWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+    write();
+}
+
+void StatsWriter::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!changed.wait_for(lock, interval, [this] { return stopping; })) {
+        lock.unlock();
+        write();
+        lock.lock();
+    }
+}
+
+void StatsWriter::write() {
+    auto stats = getMetrics().toJson();
+    stats["wallSeconds"] = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - started).count();
+
+    // Stats are best effort, never worth stopping playback for.
+    auto tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios_base::trunc);
+    file << stats << std::endl;
+    file.close();
+    if (file.fail() || rename(tempPath.c_str(), path.c_str()) < 0) {
+        std::cerr << "Cannot write stats to " << path << std::endl;
+    }
+}
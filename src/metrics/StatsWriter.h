@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Rewrites a JSON snapshot of getMetrics() to a file every interval on a background thread, and once more on exit.
+ * The file is replaced atomically so a reader never sees half of it.
+ */
+class StatsWriter {
+    std::string path;
+    std::chrono::seconds interval;
+    std::chrono::steady_clock::time_point started;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping;
+    std::thread worker;
+
+    void work();
+    void write();
+
+public:
+    /**
+     * @param intervalSeconds Must be > 0.
+     */
+    StatsWriter(const std::string& path, int intervalSeconds);
+    ~StatsWriter();
+};
@@ -0,0 +1,29 @@
+#include "PlaybackClock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std::chrono;
+
+const double SECONDS_PER_HOUR = 60 * 60;
+const double SECONDS_PER_DAY = 24 * SECONDS_PER_HOUR;
+
+PlaybackClock::PlaybackClock(const PlaybackOptions& options, int64_t startedAt, double durationSeconds)
+    : startedAt(system_clock::from_time_t((time_t) startedAt)) {
+    rate = options.daysPerMovie > 0
+            ? durationSeconds / (options.daysPerMovie * SECONDS_PER_DAY)
+            : options.movieSecondsPerHour / SECONDS_PER_HOUR;
+    if (!(rate > 0)) {
+        throw std::runtime_error("Wall clock playback needs a positive movieSecondsPerHour, or daysPerMovie and a movie of known length");
+    }
+}
+
+int64_t PlaybackClock::getPosition(system_clock::time_point time) const {
+    auto elapsed = duration_cast<microseconds>(time - startedAt).count();
+    return std::max((int64_t) 0, (int64_t) std::llround(elapsed * rate));
+}
+
+system_clock::time_point PlaybackClock::getTime(int64_t position) const {
+    return startedAt + duration_cast<system_clock::duration>(microseconds(std::llround(position / rate)));
+}
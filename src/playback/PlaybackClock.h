@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "../config/Config.h"
+
+/**
+ * Maps wall clock time to a position in a movie for wall clock playback. Positions are in microseconds from the first
+ * frame, FrameService converts them to and from pts.
+ */
+class PlaybackClock {
+    std::chrono::system_clock::time_point startedAt;
+
+    /**
+     * Movie seconds per wall clock second.
+     */
+    double rate;
+
+public:
+    /**
+     * @param startedAt Unix time the movie started playing
+     * @param durationSeconds Length of the movie, only needed with daysPerMovie
+     */
+    PlaybackClock(const PlaybackOptions& options, int64_t startedAt, double durationSeconds);
+
+    /**
+     * @return how far into the movie playback should be at time, never before the start.
+     */
+    int64_t getPosition(std::chrono::system_clock::time_point time) const;
+
+    /**
+     * @return when playback reaches position.
+     */
+    std::chrono::system_clock::time_point getTime(int64_t position) const;
+};
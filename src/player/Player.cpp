@@ -0,0 +1,125 @@
+#include "Player.h"
+
+#include <future>
+#include <iostream>
+#include <sstream>
+
+#include "../bake/BakedMovie.h"
+#include "../display/Display.h"
+#include "../metrics/Metrics.h"
+
+Player::Player(Config *config, PanelOptions *panel, PrefetchWorkers *workers,
+               std::chrono::steady_clock::time_point started)
+    : config(config), panel(panel), workers(workers), started(started) {
+    playlist.reset(new Playlist(config, panel));
+    sleep.reset(new SleepService(&panel->options));
+}
+
+void Player::log(const std::string& message) const {
+    // Panels play on their own threads, so each line goes out whole.
+    std::stringstream ss;
+    if (!panel->name.empty()) {
+        ss << "[" << panel->name << "] ";
+    }
+    ss << message << "\n";
+    std::cout << ss.str() << std::flush;
+}
+
+/**
+ * Plays the baked frames of a movie if they are up to date with the options, otherwise decodes on the fly. Bakes
+ * follow frameSkip, so wall clock playback always decodes.
+ */
+std::unique_ptr<FrameSource> Player::openFrameSource(const State& state) {
+    auto& options = panel->options;
+    const auto width = options.display.width;
+    const auto height = options.display.height;
+    if (options.playback.mode == frameSkipPlayback) {
+        auto baked = BakedMovie::tryOpen(config->getBakePath(state.file),
+                                         getBakeKey(state.file, options, width, height), width, height);
+        if (baked) {
+            log("Playing baked frames of " + state.file);
+            baked->seekAfter(state.pts);
+            return baked;
+        }
+    }
+
+    // Movies in the panel's path were probed by its library, which saves reading ahead in them again to open them.
+    std::unique_ptr<MovieInfo> movie;
+    auto slash = state.file.find_last_of('/');
+    if (slash != std::string::npos && state.file.substr(0, slash) == options.path) {
+        movie = config->getLibrary(options.path).find(state.file.substr(slash + 1));
+    }
+
+    return std::unique_ptr<FrameSource>(new PrefetchService(
+            state.file, config->getIndexPath(state.file), movie.get(), &options, width, height, state.pts,
+            state.startedAt, workers));
+}
+
+void Player::run() {
+    // Exporting the pins and powering the panel on take seconds, as can opening and seeking the movie, so overlap them.
+    auto displayReady = std::async(std::launch::async, [this] {
+        auto display = createDisplay(panel->options.display);
+        display->init();
+        getMetrics().displayInit.recordSince(started);
+        return display;
+    });
+    std::unique_ptr<Display> display;
+
+    auto state = playlist->getState();
+    if (!state) {
+        state = playlist->setNextState();
+    }
+
+    while (state) {
+        auto source = openFrameSource(*state);
+        PreparedFrame frame;
+
+        log("Writing file " + state->file
+            + (state->pts == NOTHING_PLAYED ? " from the start" : " after " + std::to_string(state->pts)));
+
+        auto firstFrame = true;
+
+        // The next frame is read from the bake, or decoded and dithered in the background, while this one is displayed.
+        while (source->tryTakeNext(frame)) {
+            auto sleepStarted = std::chrono::steady_clock::now();
+            auto paused = sleep->sleepUntilHoursOfOperation();
+            if (panel->options.playback.mode == wallClockPlayback) {
+                // The frame prepared before the pause is long overdue, start again from where the clock is now.
+                if (paused) {
+                    source = openFrameSource(*state);
+                    continue;
+                }
+                sleep->waitUntil(frame.showAt);
+            } else if (firstFrame) {
+                firstFrame = false;
+                sleep->reset();
+            } else {
+                sleep->sleepAndReset();
+            }
+            auto slept = std::chrono::steady_clock::now() - sleepStarted;
+
+            auto booting = !display;
+            if (booting) {
+                display = displayReady.get();
+            }
+            log("Displaying frame " + std::to_string(frame.pts));
+            display->write(frame.bitmap);
+            log("Refreshed in " + std::to_string(display->getLastRefreshMs()) + "ms");
+
+            // Time spent waiting for the hours of operation is not part of booting.
+            if (booting) {
+                auto bootNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - started - slept).count();
+                getMetrics().firstFrame.record(bootNanoseconds);
+                log("First frame shown " + std::to_string(bootNanoseconds / 1000000) + "ms after start");
+            }
+            getMetrics().framesDisplayed.add(1);
+
+            playlist->setPts(*state, frame.pts);
+        }
+
+        state = playlist->setNextState();
+    }
+
+    std::cerr << "No movie files found in " << panel->options.path << std::endl;
+}
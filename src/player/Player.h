@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include "../config/Config.h"
+#include "../config/Playlist.h"
+#include "../prefetch/PrefetchService.h"
+#include "../sleep/SleepService.h"
+
+/**
+ * Plays the movies of one panel on its display, one after another from wherever it last left off.
+ */
+class Player {
+    Config *config;
+    PanelOptions *panel;
+    PrefetchWorkers *workers;
+    std::chrono::steady_clock::time_point started;
+    std::unique_ptr<Playlist> playlist;
+    std::unique_ptr<SleepService> sleep;
+
+    std::unique_ptr<FrameSource> openFrameSource(const State& state);
+
+    /**
+     * Writes a line to stdout, prefixed with the panel name if it has one.
+     */
+    void log(const std::string& message) const;
+
+public:
+    /**
+     * @param workers Shared with the players of every other panel.
+     * @param started When the process started, boot time is measured from it.
+     */
+    Player(Config *config, PanelOptions *panel, PrefetchWorkers *workers,
+           std::chrono::steady_clock::time_point started);
+
+    /**
+     * Plays until there are no movies left to play.
+     */
+    void run();
+};
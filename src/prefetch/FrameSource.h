@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct PreparedFrame {
+    int64_t pts;
+
+    /**
+     * In wall clock playback, when the frame is due to be shown. Unset otherwise.
+     */
+    std::chrono::system_clock::time_point showAt;
+
+    /**
+     * The 1bpp bitmap in the layout of DitherService::result.
+     */
+    std::vector<uint8_t> bitmap;
+};
+
+/**
+ * Somewhere the player gets ready to display frames of a movie from.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * Takes the next frame to display.
+     * @return true if there was a frame, false at the end of the movie
+     */
+    virtual bool tryTakeNext(PreparedFrame& frame) = 0;
+};
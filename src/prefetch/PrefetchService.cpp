@@ -0,0 +1,129 @@
+#include "PrefetchService.h"
+#include "../metrics/Metrics.h"
+
+PrefetchWorkers::PrefetchWorkers(const Options& options) : frameSlots(options.panelWorkers) {
+    if (options.dither.threads != 1) {
+        pool.reset(new WorkerPool(options.dither.threads));
+    }
+}
+
+PrefetchService::PrefetchService(const std::string& file, const std::string& indexPath, const MovieInfo *movie,
+                                 Options *options, int screenWidth, int screenHeight, int64_t lastPts,
+                                 int64_t startedAt, PrefetchWorkers *workers)
+    : workers(workers), frameSkip(options->frameSkip), displaySeconds(options->displaySeconds), finished(false),
+      stopping(false) {
+    frameService.reset(new FrameService(file, indexPath, movie, options));
+    ditherService.reset(new DitherService(frameService->getFormat(), options, screenWidth, screenHeight,
+                                          workers ? workers->pool.get() : nullptr));
+
+    if (options->playback.mode == wallClockPlayback && startedAt >= 0) {
+        // Jump to wherever the clock is now, however long playback was stopped for.
+        clock.reset(new PlaybackClock(options->playback, startedAt, frameService->getDurationSeconds()));
+        startPts = frameService->getPtsAt(clock->getPosition(std::chrono::system_clock::now()));
+    } else {
+        // Step frameSkip frames per displayed frame by timestamp, so the decoder can drop the frames in between.
+        // A new movie starts from its first frame, which may be before 0. Older journals hold -1 for a new movie,
+        // which still starts one whose stream begins at or after 0 from its first frame.
+        auto firstPts = frameService->getFirstPts();
+        auto started = lastPts != AV_NOPTS_VALUE && (firstPts == AV_NOPTS_VALUE || lastPts >= firstPts);
+        startPts = started ? frameService->getPtsAfter(lastPts, frameSkip) : firstPts;
+    }
+    worker = std::thread(&PrefetchService::work, this);
+}
+
+PrefetchService::~PrefetchService() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+void PrefetchService::work() {
+    try {
+        AVFrame *frame = nullptr;
+        auto pts = startPts;
+        while (true) {
+            DitherOutcome outcome;
+            {
+                // Other panels wait their turn for the decoding and dithering, never for a frame waiting to be shown.
+                WorkSlot slot(workers ? &workers->frameSlots : nullptr);
+                if (!frameService->trySeek(pts, &frame)) {
+                    break;
+                }
+                outcome = ditherService->tryDither(frame);
+            }
+
+            // Skip black frames to the first lit one, and frames that would not change the panel to the next step.
+            if (outcome == frameBlack) {
+                getMetrics().blackFramesSkipped.add(1);
+                pts = frame->pts + 1;
+                continue;
+            }
+            if (outcome == frameUnchanged) {
+                getMetrics().unchangedFramesSkipped.add(1);
+                pts = getNextPts(frame->pts);
+                continue;
+            }
+
+            std::unique_ptr<PreparedFrame> prepared(new PreparedFrame {
+                .pts = frame->pts,
+                .showAt = clock ? clock->getTime(frameService->getPosition(frame->pts)) : std::chrono::system_clock::time_point(),
+                .bitmap = ditherService->result,
+            });
+            if (!tryPublish(std::move(prepared))) {
+                return;
+            }
+            pts = getNextPts(frame->pts);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    changed.notify_all();
+}
+
+int64_t PrefetchService::getNextPts(int64_t pts) const {
+    if (!clock) {
+        return frameService->getPtsAfter(pts, frameSkip);
+    }
+
+    // Movies slower than a frame per displaySeconds show every frame, each when it is due.
+    auto next = clock->getTime(frameService->getPosition(pts)) + std::chrono::seconds(displaySeconds);
+    return std::max(frameService->getPtsAt(clock->getPosition(next)), pts + 1);
+}
+
+bool PrefetchService::tryPublish(std::unique_ptr<PreparedFrame> frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return stopping || !ready; });
+    if (stopping) {
+        return false;
+    }
+    ready = std::move(frame);
+    lock.unlock();
+    changed.notify_all();
+    return true;
+}
+
+bool PrefetchService::tryTakeNext(PreparedFrame& frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return ready || finished; });
+    if (!ready) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return false;
+    }
+
+    frame = std::move(*ready);
+    ready.reset();
+    lock.unlock();
+    changed.notify_all();
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../config/Config.h"
+#include "../dither/DitherService.h"
+#include "../frame/FrameService.h"
+#include "../playback/PlaybackClock.h"
+#include "../worker/WorkerPool.h"
+#include "../worker/WorkSlots.h"
+#include "FrameSource.h"
+
+/**
+ * Shared by the prefetch services of every panel, so that together they prepare at most panelWorkers frames at once
+ * and dither on one set of threads rather than a set each.
+ */
+struct PrefetchWorkers {
+    WorkSlots frameSlots;
+    std::unique_ptr<WorkerPool> pool;
+
+    explicit PrefetchWorkers(const Options& options);
+};
+
+/**
+ * Decodes and dithers the next displayable frame of a movie on a background thread, so that it is ready to send as
+ * soon as the current frame has been shown for long enough. Black frames are skipped on the worker.
+ * Frames step by frameSkip, or in wall clock playback straight to the frame due displaySeconds after the last.
+ */
+class PrefetchService : public FrameSource {
+    std::unique_ptr<FrameService> frameService;
+    std::unique_ptr<DitherService> ditherService;
+    std::unique_ptr<PlaybackClock> clock;
+    PrefetchWorkers *workers;
+    int frameSkip;
+    int displaySeconds;
+    int64_t startPts;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::unique_ptr<PreparedFrame> ready;
+    bool finished;
+    bool stopping;
+    std::exception_ptr error;
+    std::thread worker;
+
+    void work();
+    int64_t getNextPts(int64_t pts) const;
+    bool tryPublish(std::unique_ptr<PreparedFrame> frame);
+
+public:
+    /**
+     * @param movie What the library found out when it probed file, nullptr if it has not.
+     * @param lastPts The last frame of the movie that was displayed, or AV_NOPTS_VALUE to start from its first
+     * frame
+     * @param startedAt Unix time the movie started playing, which wall clock playback starts from instead of
+     * lastPts. < 0 to step by frameSkip whatever the options, as baking does.
+     * @param workers Shared with the other panels, nullptr if this is the only movie being prepared.
+     */
+    PrefetchService(const std::string& file, const std::string& indexPath, const MovieInfo *movie, Options *options,
+                    int screenWidth, int screenHeight, int64_t lastPts, int64_t startedAt, PrefetchWorkers *workers);
+    ~PrefetchService() override;
+
+    /**
+     * Waits for the next frame to be prepared and takes it, the worker then starts on the one after.
+     * Rethrows anything the worker threw.
+     * @return true if there was a frame, false at the end of the movie
+     */
+    bool tryTakeNext(PreparedFrame& frame) override;
+};
@@ -2,6 +2,7 @@
 #include "SleepService.h"
 #include <unistd.h>
 #include <iostream>
+#include <thread>
 #include <date/date.h>
 
 using namespace std::chrono;
@@ -33,9 +34,9 @@ void SleepService::sleepAndReset() {
     reset();
 }
 
-void SleepService::sleepUntilHoursOfOperation() const {
+bool SleepService::sleepUntilHoursOfOperation() const {
     if (!schedule->enabled) {
-        return;
+        return false;
     }
 
     const auto now = floor<seconds>(system_clock::now());
@@ -46,11 +47,18 @@ void SleepService::sleepUntilHoursOfOperation() const {
     if (now < from) {
         std::cout << "hours of operation are " << from << " - " << to << ", current time is " << now << ", sleeping until " << from << std::endl;
         sleepUntil(now, from);
+        return true;
     } else if (now >= to) {
         const auto tomorrow = from + days(1);
         std::cout << "hours of operation are " << from << " - " << to << ", current time is " << now << ", sleeping until " << tomorrow << std::endl;
         sleepUntil(now, tomorrow);
+        return true;
     }
+    return false;
+}
+
+void SleepService::waitUntil(system_clock::time_point time) const {
+    std::this_thread::sleep_until(time);
 }
 
 
@@ -12,5 +12,13 @@ public:
     explicit SleepService(Options* options);
     void reset();
     void sleepAndReset();
-    void sleepUntilHoursOfOperation() const;
+    /**
+     * @return true if it had to sleep.
+     */
+    bool sleepUntilHoursOfOperation() const;
+
+    /**
+     * Sleeps until time, if it is in the future.
+     */
+    void waitUntil(std::chrono::system_clock::time_point time) const;
 };
\ No newline at end of file
@@ -1,15 +1,26 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 
+/**
+ * An SPI bus the e-paper panel is written over.
+ */
 class Spi {
-    int fd;
-
 public:
-    explicit Spi(const std::string& device);
-    ~Spi();
-    void transfer(const uint8_t *writeBuffer, const uint8_t *readBuffer, uint32_t length) const;
-    void write(const uint8_t *buffer, uint8_t length) const;
+    virtual ~Spi() = default;
+
+    /**
+     * Writes a buffer of any length, in as few transfers as the bus allows.
+     */
+    virtual void write(const uint8_t *buffer, size_t length) const = 0;
     void writeByte(uint8_t value) const;
-};
\ No newline at end of file
+};
+
+/**
+ * Opens a spidev device.
+ * @param speed Clock speed in Hz.
+ */
+std::unique_ptr<Spi> openSpi(const std::string& device, uint32_t speed);
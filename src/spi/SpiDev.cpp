@@ -0,0 +1,97 @@
+#include "SpiDev.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include <vector>
+#include "../metrics/Metrics.h"
+
+const uint8_t BITS_PER_WORD = 8;
+const uint8_t MODE = SPI_MODE_0;
+
+// spidev rejects any message bigger than its bufsiz module parameter, 4096 unless raised on the kernel command line.
+const char *BUFSIZ_PATH = "/sys/module/spidev/parameters/bufsiz";
+const size_t DEFAULT_BUFSIZ = 4096;
+
+// Kept small enough for any controller's DMA limit, larger writes become several segments.
+const size_t MAX_SEGMENT = 4096;
+const size_t MAX_SEGMENTS_PER_MESSAGE = 64;
+
+size_t getSpidevBufferSize() {
+    std::ifstream file(BUFSIZ_PATH);
+    size_t size = 0;
+    if (file >> size && size > 0) {
+        return size;
+    }
+    return DEFAULT_BUFSIZ;
+}
+
+SpiDev::SpiDev(const std::string& device, uint32_t speed) : speed(speed), bufferSize(getSpidevBufferSize()) {
+    if ((fd = open(device.c_str(), O_RDWR)) < 0) {
+        std::stringstream ss;
+        ss << "Cannot open spi device " << device;
+        throw std::runtime_error(ss.str());
+    }
+
+    if (ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &BITS_PER_WORD) < 0) {
+        throw std::runtime_error("Cannot set SPI bits per word");
+    }
+
+    if (ioctl(fd, SPI_IOC_WR_MODE, &MODE) < 0) {
+        throw std::runtime_error("Cannot set SPI mode");
+    }
+
+    if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+        throw std::runtime_error("Cannot set SPI speed");
+    }
+}
+
+SpiDev::~SpiDev() {
+    close(fd);
+}
+
+void SpiDev::transfer(const uint8_t *writeBuffer, const uint8_t *readBuffer, uint32_t length) const {
+    spi_ioc_transfer message {
+        .tx_buf = (unsigned long) writeBuffer,
+        .rx_buf = (unsigned long) readBuffer,
+        .len = length,
+        .speed_hz = speed,
+        .bits_per_word = BITS_PER_WORD,
+    };
+    if (ioctl(fd, SPI_IOC_MESSAGE(1), &message) < 0) {
+        throw std::runtime_error("Failure during SPI transfer");
+    }
+}
+
+void SpiDev::write(const uint8_t *buffer, size_t length) const {
+    getMetrics().spiBytes.add(length);
+    const auto segmentLength = std::min(bufferSize, MAX_SEGMENT);
+    const auto segmentsPerMessage = std::max((size_t) 1, std::min(bufferSize / segmentLength, MAX_SEGMENTS_PER_MESSAGE));
+
+    std::vector<spi_ioc_transfer> segments;
+    segments.reserve(segmentsPerMessage);
+    auto end = buffer + length;
+    while (buffer < end) {
+        segments.clear();
+        while (buffer < end && segments.size() < segmentsPerMessage) {
+            auto count = (uint32_t) std::min(segmentLength, (size_t) (end - buffer));
+            segments.push_back({
+                .tx_buf = (unsigned long) buffer,
+                .rx_buf = 0,
+                .len = count,
+                .speed_hz = speed,
+                .bits_per_word = BITS_PER_WORD,
+            });
+            buffer += count;
+        }
+
+        if (ioctl(fd, SPI_IOC_MESSAGE(segments.size()), segments.data()) < 0) {
+            throw std::runtime_error("Failure during SPI transfer");
+        }
+    }
+}
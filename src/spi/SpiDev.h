@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Spi.h"
+
+/**
+ * A /dev/spidevB.C device held open for its lifetime.
+ */
+class SpiDev : public Spi {
+    int fd;
+    uint32_t speed;
+    size_t bufferSize;
+
+public:
+    /**
+     * @param speed Clock speed in Hz.
+     */
+    SpiDev(const std::string& device, uint32_t speed);
+    ~SpiDev() override;
+    void transfer(const uint8_t *writeBuffer, const uint8_t *readBuffer, uint32_t length) const;
+
+    /**
+     * Writes in as few ioctls as spidev allows, several transfer segments per message with no message larger than the
+     * spidev bufsiz.
+     */
+    void write(const uint8_t *buffer, size_t length) const override;
+};
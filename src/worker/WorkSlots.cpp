@@ -0,0 +1,31 @@
+#include "WorkSlots.h"
+
+#include <algorithm>
+
+WorkSlots::WorkSlots(int slots) : available(std::max(slots, 1)) {}
+
+void WorkSlots::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this] { return available > 0; });
+    available--;
+}
+
+void WorkSlots::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        available++;
+    }
+    released.notify_one();
+}
+
+WorkSlot::WorkSlot(WorkSlots *slots) : slots(slots) {
+    if (slots) {
+        slots->acquire();
+    }
+}
+
+WorkSlot::~WorkSlot() {
+    if (slots) {
+        slots->release();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Limits how many threads do something at once, the rest wait in acquire for one of them to finish.
+ */
+class WorkSlots {
+    std::mutex mutex;
+    std::condition_variable released;
+    int available;
+
+public:
+    /**
+     * @param slots How many threads may hold a slot at once, at least 1.
+     */
+    explicit WorkSlots(int slots);
+
+    void acquire();
+    void release();
+};
+
+/**
+ * Holds a slot from construction to destruction, or nothing if slots is nullptr.
+ */
+class WorkSlot {
+    WorkSlots *slots;
+
+public:
+    explicit WorkSlot(WorkSlots *slots);
+    ~WorkSlot();
+
+    WorkSlot(const WorkSlot&) = delete;
+    WorkSlot& operator=(const WorkSlot&) = delete;
+};
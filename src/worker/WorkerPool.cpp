@@ -0,0 +1,82 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <memory>
+
+WorkerPool::WorkerPool(int threads) : stopping(false) {
+    if (threads <= 0) {
+        threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The calling thread always takes part, so we need one less worker.
+    for (auto i = 1; i < threads; i++) {
+        this->threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+int WorkerPool::concurrency() const {
+    return (int) threads.size() + 1;
+}
+
+void WorkerPool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
+
+/**
+ * Completion state shared between the caller and the workers of one parallelFor.
+ */
+struct ParallelForState {
+    std::mutex mutex;
+    std::condition_variable finished;
+    int remaining;
+};
+
+void WorkerPool::parallelFor(int count, const std::function<void(int)>& task) {
+    if (count <= 0) {
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>();
+    state->remaining = count - 1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto i = 1; i < count; i++) {
+            jobs.emplace([state, &task, i] {
+                task(i);
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (--state->remaining == 0) {
+                    state->finished.notify_all();
+                }
+            });
+        }
+    }
+    jobAvailable.notify_all();
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->remaining == 0; });
+}
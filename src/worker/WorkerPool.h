@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads for splitting per-frame work across cores.
+ */
+class WorkerPool {
+    std::vector<std::thread> threads;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping;
+
+    void work();
+
+public:
+    /**
+     * @param threads Number of worker threads, 0 for one per core.
+     */
+    explicit WorkerPool(int threads);
+    ~WorkerPool();
+
+    /**
+     * @return the number of threads that can run a parallelFor at once, including the calling thread.
+     */
+    int concurrency() const;
+
+    /**
+     * Runs task(0) .. task(count - 1) across the workers and the calling thread, returning once all have finished.
+     * Tasks are not guaranteed to run concurrently (the workers may be busy), so a task must never wait for another
+     * task to start.
+     */
+    void parallelFor(int count, const std::function<void(int)>& task);
+};
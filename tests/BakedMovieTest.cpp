@@ -0,0 +1,94 @@
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include "../src/bake/BakedMovie.h"
+#include "Test.h"
+
+const int BAKE_WIDTH = 64;
+const int BAKE_HEIGHT = 16;
+const uint64_t BAKE_KEY = 42;
+
+std::vector<uint8_t> getBakeFrame(int index) {
+    std::vector<uint8_t> bitmap(BAKE_WIDTH * BAKE_HEIGHT / 8, 0);
+    for (size_t i = 0; i < bitmap.size(); i++) {
+        bitmap[i] = (uint8_t) (i % 7 == 0 ? index * 31 + i : 0);
+    }
+    return bitmap;
+}
+
+/**
+ * Bakes frames pts 0, 10, 20... into a fresh temporary directory.
+ */
+std::string writeBake(int frames) {
+    auto path = getTemporaryDirectory() + "/movie.bake";
+    BakeWriter writer(path, BAKE_KEY, BAKE_WIDTH, BAKE_HEIGHT, BAKE_WIDTH * BAKE_HEIGHT / 8);
+    for (auto index = 0; index < frames; index++) {
+        writer.append({ .pts = index * 10, .bitmap = getBakeFrame(index) });
+    }
+    writer.finish();
+    return path;
+}
+
+off_t getFileSize(const std::string& path) {
+    return (off_t) std::ifstream(path, std::ios::ate | std::ios::binary).tellg();
+}
+
+template <class T>
+void overwrite(const std::string& path, size_t offset, T value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.write((const char *) &value, sizeof(value));
+}
+
+std::unique_ptr<BakedMovie> openBake(const std::string& path) {
+    return BakedMovie::tryOpen(path, BAKE_KEY, BAKE_WIDTH, BAKE_HEIGHT);
+}
+
+TEST(bakedMoviePlaysEveryFrame) {
+    auto path = writeBake(3);
+    auto movie = openBake(path);
+    CHECK(movie && movie->frameCount() == 3);
+    if (!movie) {
+        return;
+    }
+
+    PreparedFrame frame;
+    for (auto index = 0; index < 3; index++) {
+        CHECK(movie->tryTakeNext(frame));
+        CHECK_MESSAGE(frame.pts == index * 10 && frame.bitmap == getBakeFrame(index), "frame " << index);
+    }
+    CHECK(!movie->tryTakeNext(frame));
+}
+
+TEST(bakedMovieRejectsOtherGeometry) {
+    auto path = writeBake(3);
+    CHECK(!BakedMovie::tryOpen(path, BAKE_KEY + 1, BAKE_WIDTH, BAKE_HEIGHT));
+    CHECK(!BakedMovie::tryOpen(path, BAKE_KEY, BAKE_WIDTH + 8, BAKE_HEIGHT));
+
+    // A header whose frame size does not follow from its width and height.
+    overwrite(path, offsetof(BakeHeader, frameBytes), (uint32_t) (BAKE_WIDTH * BAKE_HEIGHT));
+    CHECK(!openBake(path));
+}
+
+TEST(bakedMovieRejectsTruncatedTable) {
+    auto path = writeBake(3);
+    // Cut off before the table, so the table offset in the header is past the end of the file.
+    truncate(path.c_str(), getFileSize(path) - 3 * sizeof(BakedFrame) - 1);
+    CHECK(!openBake(path));
+
+    path = writeBake(3);
+    truncate(path.c_str(), getFileSize(path) - sizeof(BakedFrame));
+    CHECK(!openBake(path));
+}
+
+TEST(bakedMovieRejectsTableOutsideFile) {
+    auto path = writeBake(3);
+    overwrite(path, offsetof(BakeHeader, tableOffset), (uint64_t) getFileSize(path) + 4096);
+    CHECK(!openBake(path));
+
+    overwrite(path, offsetof(BakeHeader, tableOffset), UINT64_MAX & ~(uint64_t) 7);
+    CHECK(!openBake(path));
+}
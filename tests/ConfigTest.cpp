@@ -0,0 +1,46 @@
+#include <fstream>
+#include <string>
+#include <nlohmann/json.hpp>
+
+#include <stdlib.h>
+#include "../src/config/Config.h"
+#include "Test.h"
+
+using json = nlohmann::json;
+
+/**
+ * Points HOME at a fresh directory holding options.json with a panel on the top level path and one on another path.
+ */
+std::string createTwoPathHome() {
+    auto home = getTemporaryDirectory();
+    setenv("HOME", home.c_str(), 1);
+    {
+        // The first run writes out the defaults to build on.
+        Config defaults;
+    }
+
+    auto optionsPath = home + "/.vsmp/options.json";
+    json j;
+    std::ifstream(optionsPath) >> j;
+    j["path"] = home + "/a";
+    j["panels"] = {
+        { { "name", "left" } },
+        { { "name", "right" }, { "path", home + "/b" }, { "display", { { "backend", "simulated" } } } },
+    };
+    std::ofstream(optionsPath, std::ios_base::trunc) << j;
+    return home;
+}
+
+TEST(moviesOfTheSameNameHaveTheirOwnIndexAndBake) {
+    auto home = createTwoPathHome();
+    Config config;
+
+    auto a = home + "/a/film.mp4";
+    auto b = home + "/b/film.mp4";
+    CHECK(config.getIndexPath(a) != config.getIndexPath(b));
+    CHECK(config.getBakePath(a) != config.getBakePath(b));
+
+    // Those of the top level path keep the names of earlier versions.
+    CHECK(config.getIndexPath(a) == home + "/.vsmp/index/film.mp4.json");
+    CHECK(config.getIndexPath(b) == config.getIndexPath(home + "/b/film.mp4"));
+}
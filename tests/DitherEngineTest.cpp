@@ -0,0 +1,195 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/display/Display.h"
+#include "../src/dither/ErrorDiffusion.h"
+#include "Test.h"
+
+/**
+ * A GRAY16 image dithered into a bitmap wider and taller than it, at an offset that is not byte aligned.
+ */
+struct DitherFixture {
+    std::string name;
+    int width;
+    int height;
+    std::vector<uint16_t> pixels;
+};
+
+const int REGION_LEFT = 5;
+const int REGION_TOP = 3;
+
+// Small enough for the wavefront to be checked quickly on every engine, yet many times its lag and publish interval.
+const int SMALL_WIDTH = 203;
+const int SMALL_HEIGHT = 61;
+
+/**
+ * A horizontal ramp brightening slowly down the image, where every level is a long run of near identical pixels and
+ * rounding differences have the most room to build up.
+ */
+DitherFixture getGradientFixture(int width, int height) {
+    DitherFixture fixture { .name = "gradient", .width = width, .height = height };
+    for (auto y = 0; y < fixture.height; y++) {
+        for (auto x = 0; x < fixture.width; x++) {
+            fixture.pixels.push_back((uint16_t) ((x * 60000 + y * 5535 * (fixture.width - 1) / (fixture.height - 1))
+                                                 / (fixture.width - 1)));
+        }
+    }
+    return fixture;
+}
+
+DitherFixture getNoiseFixture(int width, int height) {
+    DitherFixture fixture { .name = "noise", .width = width, .height = height };
+    std::mt19937 random(5);
+    std::uniform_int_distribution<int> values(0, 0xFFFF);
+    for (auto i = 0; i < fixture.width * fixture.height; i++) {
+        fixture.pixels.push_back((uint16_t) values(random));
+    }
+    return fixture;
+}
+
+/**
+ * Gentle curves like those of a real frame, between the gradient and the noise.
+ */
+DitherFixture getWaveFixture(int width, int height) {
+    DitherFixture fixture { .name = "wave", .width = width, .height = height };
+    for (auto y = 0; y < fixture.height; y++) {
+        for (auto x = 0; x < fixture.width; x++) {
+            fixture.pixels.push_back((uint16_t) (32767 + 26000 * std::sin(x * 0.02) * std::cos(y * 0.03)));
+        }
+    }
+    return fixture;
+}
+
+std::vector<uint8_t> dither(DitherEngine& engine, const DitherFixture& fixture) {
+    const auto bitmapWidth = (REGION_LEFT + fixture.width + 7) / 8 * 8 + 8;
+    const auto bitmapHeight = REGION_TOP + fixture.height + 2;
+    std::vector<uint8_t> bitmap(bitmapWidth * bitmapHeight / 8, 0xA5);
+    engine.dither({
+        .source = fixture.pixels.data(),
+        .sourceLineSize = fixture.width,
+        .width = fixture.width,
+        .height = fixture.height,
+        .bitmap = bitmap.data(),
+        .bitmapWidth = bitmapWidth,
+        .left = REGION_LEFT,
+        .top = REGION_TOP,
+    });
+    return bitmap;
+}
+
+int countDifferentPixels(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    auto count = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        for (auto bits = a[i] ^ b[i]; bits; bits &= bits - 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Runs the kernel over a single error and returns the error rows it diffused into.
+ */
+template <class Kernel, class T>
+std::vector<T> diffuse(T error) {
+    const auto rowLength = 8;
+    std::vector<T> errors(Kernel::rows * rowLength, 0);
+    T *rows[Kernel::rows];
+    for (auto r = 0; r < Kernel::rows; r++) {
+        rows[r] = errors.data() + r * rowLength + ERROR_DIFFUSION_PADDING;
+    }
+    Kernel::diffuse(error, rows, 1);
+    return errors;
+}
+
+/**
+ * Each fixed point share is the floating point share of the error rounded towards zero, bar the last share of a
+ * kernel that passes on all of its error, which takes whatever is left so that exactly the whole error is passed on.
+ */
+template <class Kernel>
+void checkFixedPointDiffusion(const char *name, bool passesOnAll) {
+    const auto white = Intensity<int32_t>::white;
+    // Every error would be half a billion of them, a prime stride reaches every fraction and both signs in far fewer.
+    for (int32_t error = -white; error <= white; error += 4099) {
+        auto fixed = diffuse<Kernel, int32_t>(error);
+        auto floating = diffuse<Kernel, double>((double) error / white);
+
+        int64_t total = 0;
+        auto notWithinLsb = 0;
+        for (size_t i = 0; i < fixed.size(); i++) {
+            total += fixed[i];
+            if (std::abs(fixed[i] - floating[i] * white) >= 1) {
+                notWithinLsb++;
+            }
+        }
+        if (passesOnAll) {
+            CHECK_MESSAGE(total == error, name << " error " << error << " passes on " << total);
+            CHECK_MESSAGE(notWithinLsb <= 1, name << " error " << error);
+        } else {
+            CHECK_MESSAGE(notWithinLsb == 0, name << " error " << error);
+        }
+    }
+}
+
+TEST(fixedPointDiffusionConservesError) {
+    checkFixedPointDiffusion<FloydSteinbergKernel>("Floyd-Steinberg", true);
+    checkFixedPointDiffusion<AtkinsonKernel>("Atkinson", false);
+    checkFixedPointDiffusion<SierraLiteKernel>("Sierra Lite", true);
+}
+
+// Bitmaps differ where a rounding difference tips a pixel across the threshold and error diffusion carries that on
+// to its neighbours. None do on these fixtures and under 0.5% on others tried, where diffusing in whole GRAY16 levels
+// differed in up to a third of the pixels.
+const double MAX_FIXED_POINT_DIFFERENCE = 0.01;
+
+template <class Kernel>
+void checkFixedPointDither(const char *name) {
+    for (const auto& fixture : { getGradientFixture(EPD_WIDTH, EPD_HEIGHT), getWaveFixture(EPD_WIDTH, EPD_HEIGHT),
+                                 getNoiseFixture(EPD_WIDTH, EPD_HEIGHT) }) {
+        ErrorDiffusionEngine<Kernel, double> floating(getPixelKernels(), fixture.width);
+        ErrorDiffusionEngine<Kernel, int32_t> fixed(getPixelKernels(), fixture.width);
+        auto expected = dither(floating, fixture);
+        auto actual = dither(fixed, fixture);
+
+        auto different = (double) countDifferentPixels(expected, actual) / (fixture.width * fixture.height);
+        CHECK_MESSAGE(different <= MAX_FIXED_POINT_DIFFERENCE,
+                      name << " " << fixture.name << " differs in " << different * 100 << "% of pixels");
+    }
+}
+
+TEST(fixedPointDitherIsCloseToFloatingPoint) {
+    checkFixedPointDither<FloydSteinbergKernel>("Floyd-Steinberg");
+    checkFixedPointDither<AtkinsonKernel>("Atkinson");
+    checkFixedPointDither<SierraLiteKernel>("Sierra Lite");
+}
+
+template <class Kernel, class T>
+void checkWavefront(const char *name) {
+    for (auto threads : { 2, 4 }) {
+        WorkerPool pool(threads);
+        for (const auto& fixture : { getGradientFixture(SMALL_WIDTH, SMALL_HEIGHT),
+                                     getNoiseFixture(SMALL_WIDTH, SMALL_HEIGHT) }) {
+            ErrorDiffusionEngine<Kernel, T> serial(getPixelKernels(), fixture.width);
+            WavefrontDiffusionEngine<Kernel, T> wavefront(getPixelKernels(), fixture.width, fixture.height, &pool);
+            auto expected = dither(serial, fixture);
+
+            // Twice, so that nothing is left over from the frame before.
+            for (auto frame = 0; frame < 2; frame++) {
+                auto actual = dither(wavefront, fixture);
+                CHECK_MESSAGE(actual == expected, name << " " << fixture.name << " on " << threads << " threads, frame "
+                              << frame << ": " << countDifferentPixels(expected, actual) << " pixels differ");
+            }
+        }
+    }
+}
+
+TEST(wavefrontMatchesSerialDither) {
+    checkWavefront<FloydSteinbergKernel, double>("Floyd-Steinberg float");
+    checkWavefront<FloydSteinbergKernel, int32_t>("Floyd-Steinberg fixed");
+    checkWavefront<AtkinsonKernel, double>("Atkinson float");
+    checkWavefront<AtkinsonKernel, int32_t>("Atkinson fixed");
+    checkWavefront<SierraLiteKernel, double>("Sierra Lite float");
+    checkWavefront<SierraLiteKernel, int32_t>("Sierra Lite fixed");
+}
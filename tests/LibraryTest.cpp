@@ -0,0 +1,98 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include <sys/stat.h>
+#include "../src/library/Library.h"
+#include "Test.h"
+
+using json = nlohmann::json;
+
+void writeMovieFile(const std::string& path, size_t size) {
+    std::ofstream(path, std::ios_base::trunc) << std::string(size, 'm');
+}
+
+json getCachedMovie(const std::string& path, const std::string& name, double blackFrameRatio) {
+    struct stat info {};
+    stat((path + "/" + name).c_str(), &info);
+    return {
+        { "name", name },
+        { "size", info.st_size },
+        { "modified", info.st_mtime },
+        { "playable", true },
+        { "duration", 60.0 },
+        { "frames", 1440 },
+        { "width", 1920 },
+        { "height", 1080 },
+        { "codec", "h264" },
+        { "blackFrameRatio", blackFrameRatio },
+        { "stream", 1 },
+        { "pixelFormat", 0 },
+        { "firstPts", -1001 },
+        { "frameRate", { 24000, 1001 } },
+    };
+}
+
+/**
+ * A movies directory whose cache already holds an ordinary, a mostly black and an unchecked movie, as if they had been
+ * probed by an earlier run, and a new movie that has not been.
+ */
+std::string createCachedLibrary(std::string& cachePath) {
+    auto path = getTemporaryDirectory();
+    cachePath = path + "/library.json";
+    writeMovieFile(path + "/a.mp4", 10);
+    writeMovieFile(path + "/b.mp4", 20);
+    writeMovieFile(path + "/c.mp4", 30);
+    json j = {
+        { "version", 2 },
+        { "path", path },
+        { "movies", { getCachedMovie(path, "a.mp4", 0.1), getCachedMovie(path, "b.mp4", 0.95),
+                      getCachedMovie(path, "c.mp4", -1) } },
+    };
+    std::ofstream(cachePath, std::ios_base::trunc) << j;
+    writeMovieFile(path + "/d.mp4", 40);
+    return path;
+}
+
+TEST(libraryKeepsProbedMetadataAcrossRestarts) {
+    std::string cachePath;
+    auto path = createCachedLibrary(cachePath);
+    {
+        // Only the new movie is probed, and as it is not really a movie the cache is written back without it playable.
+        Library library(path, cachePath);
+        CHECK(library.find("d.mp4") && !library.find("d.mp4")->playable);
+    }
+
+    Library library(path, cachePath);
+    auto movie = library.find("a.mp4");
+    CHECK(movie && movie->playable);
+    if (!movie) {
+        return;
+    }
+    CHECK(movie->durationSeconds == 60 && movie->frameCount == 1440 && movie->codec == "h264");
+    CHECK(movie->width == 1920 && movie->height == 1080 && movie->blackFrameRatio == 0.1);
+    CHECK(movie->streamIndex == 1 && movie->pixelFormat == 0 && movie->firstPts == -1001);
+    CHECK(movie->frameRateNum == 24000 && movie->frameRateDen == 1001);
+}
+
+TEST(libraryPassesOverMostlyBlackMovies) {
+    std::string cachePath;
+    auto path = createCachedLibrary(cachePath);
+    Library library(path, cachePath);
+
+    CHECK((library.getPlayable(0.9) == std::vector<std::string> { "a.mp4", "c.mp4" }));
+    CHECK((library.getPlayable(1) == std::vector<std::string> { "a.mp4", "b.mp4", "c.mp4" }));
+}
+
+TEST(libraryDoesNotFindChangedMovies) {
+    std::string cachePath;
+    auto path = createCachedLibrary(cachePath);
+    Library library(path, cachePath);
+    CHECK(library.find("b.mp4") != nullptr);
+
+    // Before any update has seen the change.
+    writeMovieFile(path + "/b.mp4", 25);
+    CHECK(library.find("b.mp4") == nullptr);
+    CHECK(library.find("e.mp4") == nullptr);
+}
@@ -0,0 +1,171 @@
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../src/dither/PixelKernels.h"
+#include "Test.h"
+
+/**
+ * Every SIMD implementation this CPU can run, plus whichever getPixelKernels() picked.
+ */
+std::vector<const PixelKernels*> getKernelsUnderTest() {
+    std::vector<const PixelKernels*> result = { &getPixelKernels() };
+#if defined(__x86_64__) || defined(__i386__)
+    result.push_back(getSse2Kernels());
+    result.push_back(getAvx2Kernels());
+#endif
+#if defined(__ARM_NEON) || defined(__aarch64__)
+    result.push_back(getNeonKernels());
+#endif
+    std::vector<const PixelKernels*> supported;
+    for (auto kernels : result) {
+        if (kernels) {
+            supported.push_back(kernels);
+        }
+    }
+    return supported;
+}
+
+/**
+ * Every count up to a few SIMD widths, so that each tail length is covered, then some panel-sized rows.
+ */
+std::vector<int> getCounts() {
+    std::vector<int> counts;
+    for (auto count = 0; count <= 70; count++) {
+        counts.push_back(count);
+    }
+    for (auto count : { 127, 128, 129, 255, 256, 257, 480, 799, 800, 803 }) {
+        counts.push_back(count);
+    }
+    return counts;
+}
+
+// Pointers are offset by up to this many elements from an aligned allocation.
+const int MAX_MISALIGNMENT = 3;
+
+TEST(anyNonZeroMatchesScalar) {
+    const auto& scalar = getScalarKernels();
+    for (auto kernels : getKernelsUnderTest()) {
+        for (auto count : getCounts()) {
+            for (auto offset = 0; offset <= MAX_MISALIGNMENT; offset++) {
+                std::vector<uint16_t> buffer(count + MAX_MISALIGNMENT, 0);
+                auto values = buffer.data() + offset;
+                CHECK_MESSAGE(kernels->anyNonZero(values, count) == scalar.anyNonZero(values, count),
+                              kernels->name << " all zero, count " << count << " offset " << offset);
+
+                // A single lit pixel must be found wherever it is, including the tail.
+                for (auto lit = 0; lit < count; lit++) {
+                    values[lit] = lit % 2 == 0 ? 1 : 0x8000;
+                    CHECK_MESSAGE(kernels->anyNonZero(values, count) == scalar.anyNonZero(values, count),
+                                  kernels->name << " lit " << lit << ", count " << count << " offset " << offset);
+                    values[lit] = 0;
+                }
+
+                // Nor may anything past count be read as part of it.
+                if (offset < MAX_MISALIGNMENT) {
+                    values[count] = 1;
+                    CHECK_MESSAGE(!kernels->anyNonZero(values, count),
+                                  kernels->name << " read past count " << count << " offset " << offset);
+                }
+            }
+        }
+    }
+}
+
+TEST(accumulateMatchesScalar) {
+    const auto& scalar = getScalarKernels();
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> values(0, 0xFFFF);
+    std::uniform_int_distribution<int32_t> errors(-0x10000, 0x10000);
+    for (auto kernels : getKernelsUnderTest()) {
+        for (auto count : getCounts()) {
+            for (auto offset = 0; offset <= MAX_MISALIGNMENT; offset++) {
+                std::vector<uint16_t> source(count + MAX_MISALIGNMENT);
+                for (auto& value : source) {
+                    value = (uint16_t) values(random);
+                }
+                std::vector<int32_t> expected(count + 2 * MAX_MISALIGNMENT);
+                for (auto& value : expected) {
+                    value = errors(random);
+                }
+                auto actual = expected;
+
+                scalar.accumulate(source.data() + offset, count, expected.data() + offset);
+                kernels->accumulate(source.data() + offset, count, actual.data() + offset);
+                CHECK_MESSAGE(actual == expected, kernels->name << " count " << count << " offset " << offset);
+            }
+        }
+    }
+}
+
+TEST(accumulateNormalisedMatchesScalar) {
+    const auto& scalar = getScalarKernels();
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> values(0, 0xFFFF);
+    std::uniform_real_distribution<double> errors(-1.0, 1.0);
+    for (auto kernels : getKernelsUnderTest()) {
+        for (auto count : getCounts()) {
+            for (auto offset = 0; offset <= MAX_MISALIGNMENT; offset++) {
+                std::vector<uint16_t> source(count + MAX_MISALIGNMENT);
+                for (auto& value : source) {
+                    value = (uint16_t) values(random);
+                }
+                std::vector<double> expected(count + 2 * MAX_MISALIGNMENT);
+                for (auto& value : expected) {
+                    value = errors(random);
+                }
+                auto actual = expected;
+
+                // Bit identical, not just close: the dither must not depend on which kernels the CPU has.
+                scalar.accumulateNormalised(source.data() + offset, count, expected.data() + offset);
+                kernels->accumulateNormalised(source.data() + offset, count, actual.data() + offset);
+                CHECK_MESSAGE(memcmp(actual.data(), expected.data(), expected.size() * sizeof(double)) == 0,
+                              kernels->name << " count " << count << " offset " << offset);
+            }
+        }
+    }
+}
+
+TEST(packBytesMatchesScalar) {
+    const auto& scalar = getScalarKernels();
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> pixels(0, 1);
+    for (auto kernels : getKernelsUnderTest()) {
+        for (auto bytes : getCounts()) {
+            for (auto offset = 0; offset <= MAX_MISALIGNMENT; offset++) {
+                std::vector<uint8_t> source(bytes * 8 + MAX_MISALIGNMENT);
+                for (auto& pixel : source) {
+                    pixel = (uint8_t) pixels(random);
+                }
+                // Guard bytes either side must be left alone.
+                std::vector<uint8_t> expected(bytes + 2 * MAX_MISALIGNMENT, 0xA5);
+                auto actual = expected;
+
+                scalar.packBytes(source.data() + offset, bytes, expected.data() + offset);
+                kernels->packBytes(source.data() + offset, bytes, actual.data() + offset);
+                CHECK_MESSAGE(actual == expected, kernels->name << " bytes " << bytes << " offset " << offset);
+            }
+        }
+    }
+}
+
+TEST(packRowMatchesScalar) {
+    const auto& scalar = getScalarKernels();
+    std::mt19937 random(4);
+    std::uniform_int_distribution<int> pixels(0, 1);
+    for (auto kernels : getKernelsUnderTest()) {
+        for (auto count : getCounts()) {
+            for (auto bitOffset = 0; bitOffset < 8; bitOffset++) {
+                std::vector<uint8_t> source(count);
+                for (auto& pixel : source) {
+                    pixel = (uint8_t) pixels(random);
+                }
+                std::vector<uint8_t> expected((bitOffset + count) / 8 + 2, 0x5A);
+                auto actual = expected;
+
+                packRow(scalar, source.data(), count, expected.data(), bitOffset);
+                packRow(*kernels, source.data(), count, actual.data(), bitOffset);
+                CHECK_MESSAGE(actual == expected, kernels->name << " count " << count << " bit offset " << bitOffset);
+            }
+        }
+    }
+}
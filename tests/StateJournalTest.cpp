@@ -0,0 +1,125 @@
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include "../src/config/StateJournal.h"
+#include "Test.h"
+
+/**
+ * CRC32 as zlib computes it, written out again here so the on-disk format is checked independently of the journal.
+ */
+uint32_t referenceCrc32(const std::string& data, uint32_t crc = 0) {
+    crc = ~crc;
+    for (auto c : data) {
+        crc ^= (uint8_t) c;
+        for (auto bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+template <class T>
+std::string bytesOf(const T& value) {
+    return std::string((const char *) &value, sizeof(value));
+}
+
+std::string getJournalPath() {
+    return getTemporaryDirectory() + "/state.journal";
+}
+
+/**
+ * A journal as written by version 1: header without startedAt, the file name, then pts records.
+ */
+std::string getVersion1Journal(const std::string& file, int64_t pts, const std::vector<int64_t>& records) {
+    std::string header = "VSMPJRNL";
+    header += bytesOf((uint32_t) 1);
+    header += bytesOf((uint32_t) file.size());
+    header += bytesOf(pts);
+    auto crc = referenceCrc32(file, referenceCrc32(header));
+    auto journal = header + bytesOf(crc) + bytesOf((uint32_t) 0) + file;
+
+    for (uint32_t sequence = 0; sequence < records.size(); sequence++) {
+        auto record = bytesOf(records[sequence]) + bytesOf(sequence);
+        journal += record + bytesOf(referenceCrc32(record));
+    }
+    return journal;
+}
+
+uint32_t readVersion(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char header[12] = {};
+    file.read(header, sizeof(header));
+    uint32_t version;
+    memcpy(&version, header + 8, sizeof(version));
+    return version;
+}
+
+TEST(stateJournalRecoversLastRecord) {
+    auto path = getJournalPath();
+    {
+        StateJournal journal(path);
+        CHECK(!journal.getState());
+        journal.checkpoint({ .file = "/movies/a.mp4", .pts = -1, .startedAt = 1234 });
+        journal.append(10);
+        journal.append(20);
+    }
+
+    StateJournal journal(path);
+    auto state = journal.getState();
+    CHECK(state && state->file == "/movies/a.mp4" && state->pts == 20 && state->startedAt == 1234);
+}
+
+TEST(stateJournalIgnoresTornRecord) {
+    auto path = getJournalPath();
+    {
+        StateJournal journal(path);
+        journal.checkpoint({ .file = "/movies/a.mp4", .pts = -1, .startedAt = 1234 });
+        journal.append(10);
+        journal.append(20);
+    }
+    // Half of the last record made it to disk.
+    truncate(path.c_str(), (off_t) std::ifstream(path, std::ios::ate | std::ios::binary).tellg() - 8);
+
+    StateJournal journal(path);
+    auto state = journal.getState();
+    CHECK(state && state->pts == 10);
+}
+
+TEST(stateJournalRecoversVersion1) {
+    auto path = getJournalPath();
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << getVersion1Journal("/movies/a.mp4", 5, { 10, 20, 30 });
+    }
+
+    auto before = time(nullptr);
+    {
+        StateJournal journal(path);
+        auto state = journal.getState();
+        CHECK(state && state->file == "/movies/a.mp4" && state->pts == 30);
+        CHECK(state && state->startedAt >= before && state->startedAt <= time(nullptr));
+        journal.append(40);
+    }
+
+    // Upgraded on recovery, so startedAt is now kept along with everything played since.
+    CHECK(readVersion(path) == 2);
+    StateJournal journal(path);
+    auto state = journal.getState();
+    CHECK(state && state->file == "/movies/a.mp4" && state->pts == 40 && state->startedAt >= before);
+}
+
+TEST(stateJournalRecoversVersion1WithoutRecords) {
+    auto path = getJournalPath();
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << getVersion1Journal("/movies/b.mp4", 7, {});
+    }
+
+    StateJournal journal(path);
+    auto state = journal.getState();
+    CHECK(state && state->file == "/movies/b.mp4" && state->pts == 7);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+/**
+ * Just enough of a test framework for vsmp_tests. TEST(name) { ... } defines a test that is run by tests/main.cpp,
+ * CHECK marks it failed and carries on so that every mismatch is reported.
+ */
+struct TestRegistration {
+    TestRegistration(const char *name, void (*test)());
+};
+
+void reportFailure(const char *file, int line, const std::string& message);
+
+/**
+ * @return a fresh temporary directory for a test to write files to.
+ */
+std::string getTemporaryDirectory();
+
+#define TEST(name) \
+    void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            reportFailure(__FILE__, __LINE__, #condition); \
+        } \
+    } while (false)
+
+#define CHECK_MESSAGE(condition, message) \
+    do { \
+        if (!(condition)) { \
+            std::stringstream checkStream; \
+            checkStream << #condition << ": " << message; \
+            reportFailure(__FILE__, __LINE__, checkStream.str()); \
+        } \
+    } while (false)
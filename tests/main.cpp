@@ -0,0 +1,54 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <stdlib.h>
+#include "Test.h"
+
+struct TestCase {
+    const char *name;
+    void (*test)();
+};
+
+std::vector<TestCase>& getTests() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+int failures = 0;
+
+TestRegistration::TestRegistration(const char *name, void (*test)()) {
+    getTests().push_back({ .name = name, .test = test });
+}
+
+void reportFailure(const char *file, int line, const std::string& message) {
+    std::cerr << file << ":" << line << ": " << message << std::endl;
+    failures++;
+}
+
+std::string getTemporaryDirectory() {
+    char directory[] = "/tmp/vsmp_tests.XXXXXX";
+    if (!mkdtemp(directory)) {
+        throw std::runtime_error("Cannot create a temporary directory");
+    }
+    return directory;
+}
+
+int main() {
+    auto failed = 0;
+    for (const auto& test : getTests()) {
+        auto before = failures;
+        try {
+            test.test();
+        } catch (const std::exception& e) {
+            reportFailure(test.name, 0, e.what());
+        }
+        auto passed = failures == before;
+        std::cout << (passed ? "PASS " : "FAIL ") << test.name << std::endl;
+        if (!passed) {
+            failed++;
+        }
+    }
+    std::cout << getTests().size() - failed << "/" << getTests().size() << " tests passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}